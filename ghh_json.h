@@ -10,6 +10,7 @@ extern "C" {
 #include <stddef.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum json_type {
     JSON_OBJECT,
@@ -18,7 +19,8 @@ typedef enum json_type {
     JSON_NUMBER,
     JSON_TRUE,
     JSON_FALSE,
-    JSON_NULL
+    JSON_NULL,
+    JSON_INTEGER // integer literals which fit in an int64_t
 } json_type_e;
 
 typedef struct json_object {
@@ -27,37 +29,272 @@ typedef struct json_object {
         struct json_vec *vec;
         char *string;
         double number;
+        int64_t integer;
+        struct json_lazy *lazy;
     } data;
 
+    size_t length; // length of string, not counting the null terminator
     json_type_e type;
+    bool lazy; // object or array which hasn't been parsed yet
 } json_object_t;
 
+// memory functions used for everything a json_t allocates. user is passed
+// back to each of them
+typedef struct json_allocator {
+    void *(*alloc)(void *user, size_t size);
+    void (*free)(void *user, void *ptr);
+    // may be NULL, in which case memory is moved with alloc and free
+    void *(*realloc)(void *user, void *ptr, size_t size);
+    void *user;
+} json_allocator_t;
+
 typedef struct json {
     json_object_t *root;
 
     // allocators
-    struct json_tptr **tracked; // fat pointer array of tracked pointers
+    json_allocator_t allocator; // where pages and parser state come from
     char **pages; // fat pointer
-    size_t cur_tracked, tracked_cap; // tracks tracked pointers
     size_t cur_page, page_cap; // tracks allocator pages
-    size_t used; // tracks current page stack
+    size_t page_count; // pages allocated, including warm ones past cur_page
+    size_t used, page_size; // tracks current page stack
+    size_t page_grow, page_max; // size of the next new page, and its limit
+    // freed container storage on the pages, one list per power of 2 size
+    void *free_blocks[sizeof(size_t) * 8];
+
+    // parser scratch, kept by json_reset() so reparsing doesn't allocate.
+    // NULL until first needed
+    struct json_frame *stack; // fat pointer
+    struct json_item *items; // fat pointer
+    uint32_t *positions; // structural index window
 } json_t;
 
+// a parse error which was caught rather than exiting
+typedef struct json_error {
+    size_t line, column; // where the error occurred, starting from 1
+    size_t offset; // where the error occurred, in bytes from the start
+    char message[128];
+} json_error_t;
+
 void json_load(json_t *, char *text);
+// strings and keys are decoded in place and point into text, which must stay
+// alive and unmodified until json_unload()
+void json_load_insitu(json_t *, char *text);
+// text doesn't need to be null terminated, nothing past len is read
+void json_load_n(json_t *, const char *text, size_t len);
+// objects and arrays are only parsed when they are first accessed, so text must
+// stay alive and unmodified until json_unload(). text[len] must be a null
+// terminator
+void json_load_lazy(json_t *, const char *text, size_t len);
 void json_load_empty(json_t *);
 void json_load_file(json_t *, const char *filepath);
+
+// options for json_load_empty_ex and the _ex loaders, which may be passed as
+// NULL for the defaults
+typedef struct json_arena_opts {
+    // length of the text which will be parsed into the json_t, if known. the
+    // first page is sized from it, otherwise it's JSON_PAGE_SIZE
+    size_t size_hint;
+    // pages double in size as they're added, up to this. 0 for
+    // JSON_MAX_PAGE_SIZE
+    size_t max_page_size;
+    // copied into the json_t. NULL for JSON_MALLOC and JSON_FREE
+    const json_allocator_t *allocator;
+} json_arena_opts_t;
+
+void json_load_empty_ex(json_t *, const json_arena_opts_t *);
+// the loaders above, with the json_t's memory set up from opts. size_hint
+// defaults to the text's length
+void json_load_ex(json_t *, char *text, const json_arena_opts_t *);
+void json_load_insitu_ex(json_t *, char *text, const json_arena_opts_t *);
+void json_load_n_ex(
+    json_t *, const char *text, size_t len, const json_arena_opts_t *
+);
+void json_load_lazy_ex(
+    json_t *, const char *text, size_t len, const json_arena_opts_t *
+);
+void json_load_file_ex(
+    json_t *, const char *filepath, const json_arena_opts_t *
+);
 void json_unload(json_t *);
+// frees everything on json, leaving it as if it were just created with
+// json_load_empty(). up to JSON_WARM_PAGES pages and the parser's scratch are
+// kept allocated for reuse
+void json_reset(json_t *);
+// json_reset, then json_load_n into the same json_t
+void json_reload_n(json_t *, const char *text, size_t len);
+
+// options for json_load_files, which may be passed as NULL for the defaults
+typedef struct json_load_opts {
+    size_t threads; // maximum number of threads to use, 0 for one per cpu
+    // if set, errors[i] holds the error for paths[i], or an empty message if it
+    // loaded. files which fail are left empty instead of exiting
+    json_error_t *errors;
+    // maximum reads in flight for json_async_load, 0 for 32
+    size_t queue_depth;
+    // passed to json_load_file_ex for every file
+    const json_arena_opts_t *arena;
+} json_load_opts_t;
+
+// loads each of paths[0..n] into out[i] in parallel, as if by json_load_file.
+// returns the number of files which failed to load
+size_t json_load_files(
+    const char **paths, size_t n, json_t *out, const json_load_opts_t *
+);
+// same as json_load_files, but with JSON_IO_URING defined files are read
+// asynchronously with io_uring and parsed as their reads complete
+size_t json_async_load(
+    const char **paths, size_t n, json_t *out, const json_load_opts_t *
+);
+
+// incremental parser, for text which arrives in chunks. json_parser_init calls
+// json_load_empty on json (json_parser_init_ex calls json_load_empty_ex with
+// opts), and the parsed json is in json->root once json_finish has been
+// called. a parser which is given up on before the end of the text is released
+// with json_parser_free
+typedef struct json_parser {
+    json_t *json;
+
+    // parser state
+    int state;
+    json_object_t *object;
+    struct json_frame *stack;
+    size_t depth, stack_cap;
+    struct json_item *items;
+    size_t item_count, item_cap;
+
+    // incomplete token carried over from the last chunk
+    char *carry;
+    size_t carry_len, carry_cap;
+    bool in_string, escaped;
+} json_parser_t;
+
+void json_parser_init(json_parser_t *, json_t *);
+void json_parser_init_ex(json_parser_t *, json_t *, const json_arena_opts_t *);
+// chunk does not need to be null terminated, and is not used after returning
+void json_feed(json_parser_t *, const char *chunk, size_t len);
+void json_finish(json_parser_t *);
+// frees the parser's buffers without parsing the rest of the text, json_finish
+// calls this itself. the json_t is left to json_unload as usual
+void json_parser_free(json_parser_t *);
+
+// sax parsing, for reading json without building objects. each callback may be
+// NULL, and returns false to stop parsing. strings and keys are not null
+// terminated, and only valid until the callback returns. integer is called for
+// JSON_INTEGER values, or number if integer is NULL
+typedef struct json_sax_handler {
+    bool (*start_object)(void *user);
+    bool (*end_object)(void *user);
+    bool (*start_array)(void *user);
+    bool (*end_array)(void *user);
+    bool (*key)(void *user, const char *key, size_t len);
+    bool (*string)(void *user, const char *string, size_t len);
+    bool (*number)(void *user, double number);
+    bool (*integer)(void *user, int64_t integer);
+    bool (*boolean)(void *user, bool value);
+    bool (*null)(void *user);
+} json_sax_handler_t;
+
+// text[len] must be a null terminator. returns false if a callback stopped
+// parsing, true otherwise
+bool json_sax_parse(
+    const char *text, size_t len, const json_sax_handler_t *, void *user
+);
+// checks that text is valid json without allocating or building anything.
+// text doesn't need to be null terminated, nothing past len is read. returns
+// false if it isn't valid, storing why in error if it isn't NULL
+bool json_validate(const char *text, size_t len, json_error_t *);
+
+// json lines reader, for newline delimited text with one json value per line.
+// records are parsed one at a time into the same json_t, so memory use doesn't
+// grow with the number of records
+typedef enum json_lines_status {
+    JSON_LINES_END,
+    JSON_LINES_OK,
+    JSON_LINES_ERROR // the record couldn't be parsed, see json_lines_t.error
+} json_lines_status_e;
+
+typedef struct json_lines {
+    const char *text;
+    size_t len, index;
+    size_t line; // line of the last record, starting from 1
+    json_error_t error;
+
+    // text read or mapped by json_lines_open
+    char *owned;
+    size_t owned_len;
+    bool mapped;
+} json_lines_t;
+
+void json_lines_open(json_lines_t *, const char *filepath);
+// text doesn't need to be null terminated, and must outlive the reader
+void json_lines_open_buffer(json_lines_t *, const char *text, size_t len);
+// parses the next non-blank line into json->root, freeing the previous record.
+// json must have been set up with json_load_empty
+json_lines_status_e json_lines_next(json_lines_t *, json_t *);
+void json_lines_close(json_lines_t *);
+
+// streams the elements of a top-level array one at a time into the same json_t,
+// so memory use is bounded by the largest element rather than the whole file
+typedef struct json_array_stream {
+    FILE *file; // file being read in chunks, NULL once all of it has been read
+    char *text; // text[len] is always a null terminator
+    size_t len, index, cap;
+
+    // mapped files give the pages before index back to the os as they go
+    size_t map_len, released;
+    bool mapped;
+
+    bool started, ended;
+} json_array_stream_t;
+
+void json_array_stream_open(json_array_stream_t *, const char *filepath);
+// parses the next element into json->root, freeing the previous one. json must
+// have been set up with json_load_empty. returns false after the last element
+bool json_array_stream_next(json_array_stream_t *, json_t *);
+void json_array_stream_close(json_array_stream_t *);
 
 // returns a string allocated with JSON_MALLOC
 // TODO make this a lot easier
 char *json_serialize(json_object_t *, bool mini, int indent, size_t *out_len);
 
+// options for the streaming serializers, which may be passed as NULL to indent
+// by 2
+typedef struct json_write_opts {
+    bool mini;
+    int indent;
+} json_write_opts_t;
+
+// called with each chunk of output, returns false to stop serializing
+typedef bool (*json_writer_fn)(void *user, const char *data, size_t len);
+
+// serialize through a fixed size buffer, which is passed to write whenever it
+// fills up. return false if write did
+bool json_serialize_to(
+    json_object_t *, const json_write_opts_t *, json_writer_fn write, void *user
+);
+bool json_serialize_file(json_object_t *, const json_write_opts_t *, FILE *);
+// only on unix-likes and windows
+bool json_serialize_fd(json_object_t *, const json_write_opts_t *, int fd);
+
+// the exact length of the output of json_serialize_to/into, without a null
+// terminator
+size_t json_serialized_size(json_object_t *, const json_write_opts_t *);
+// serialize into buf without allocating, like snprintf: at most cap - 1 chars
+// are written and null terminated. returns the length of the whole output, so
+// it only all fit if the result is less than cap
+size_t json_serialize_into(
+    json_object_t *, const json_write_opts_t *, char *buf, size_t cap
+);
+
 // take an object, retrieve data and cast
 json_object_t *json_get_object(json_object_t *, char *key);
 // returns actual, mutable array pointer. do not modify.
 json_object_t **json_get_array(json_object_t *, char *key, size_t *out_size);
 char *json_get_string(json_object_t *, char *key);
+// also stores the string's length, which may include decoded nulls
+char *json_get_string_len(json_object_t *, char *key, size_t *out_len);
 double json_get_number(json_object_t *, char *key);
+int64_t json_get_int64(json_object_t *, char *key);
 bool json_get_bool(json_object_t *, char *key);
 
 // returns actual, mutable array pointer. do not modify.
@@ -66,7 +303,11 @@ char **json_get_keys(json_object_t *, size_t *out_size);
 // cast an object to a data type
 json_object_t **json_to_array(json_object_t *, size_t *out_size);
 char *json_to_string(json_object_t *);
+char *json_to_string_len(json_object_t *, size_t *out_len);
+// accepts both JSON_NUMBER and JSON_INTEGER
 double json_to_number(json_object_t *);
+// numbers are truncated and clamped to the range of int64_t, NaN gives 0
+int64_t json_to_int64(json_object_t *);
 bool json_to_bool(json_object_t *);
 
 // remove a json_object from another json_object (unordered)
@@ -86,6 +327,7 @@ void json_put_array(
 );
 void json_put_string(json_t *, json_object_t *, char *key, char *string);
 void json_put_number(json_t *, json_object_t *, char *key, double number);
+void json_put_int64(json_t *, json_object_t *, char *key, int64_t integer);
 void json_put_bool(json_t *, json_object_t *, char *key, bool value);
 void json_put_null(json_t *, json_object_t *, char *key);
 
@@ -94,6 +336,7 @@ json_object_t *json_new_object(json_t *);
 json_object_t *json_new_array(json_t *, json_object_t **objects, size_t size);
 json_object_t *json_new_string(json_t *, char *string);
 json_object_t *json_new_number(json_t *, double number);
+json_object_t *json_new_int64(json_t *, int64_t integer);
 json_object_t *json_new_bool(json_t *, bool value);
 json_object_t *json_new_null(json_t *);
 
@@ -105,6 +348,66 @@ json_object_t *json_copy(json_t *, json_object_t *);
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#include <setjmp.h>
+
+// define JSON_NO_SIMD to force the portable scalar code paths
+#if !defined(JSON_NO_SIMD) && defined(__AVX2__)
+#define JSON_AVX2
+#include <immintrin.h>
+#elif !defined(JSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define JSON_SSE2
+#include <emmintrin.h>
+#endif
+
+// define JSON_NO_MMAP to always read files with stdio
+#if !defined(JSON_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define JSON_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// define JSON_THREADS on unix-likes for json_load_files() to load files in
+// parallel with pthreads, which also needs linking with -pthread. otherwise
+// files are loaded one by one
+#if defined(JSON_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define JSON_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// define JSON_IO_URING on linux to read files for json_async_load() with
+// io_uring. when it isn't defined or the kernel doesn't allow it,
+// json_async_load() uses json_load_files() instead. strict -std=c99 builds
+// also need _DEFAULT_SOURCE for syscall()
+#if defined(JSON_IO_URING) && defined(__linux__)
+#define JSON_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// file descriptor writes for json_serialize_fd()
+#if defined(__unix__) || defined(__APPLE__)
+#define JSON_FD
+#define JSON_FD_WRITE(fd, data, len) write(fd, data, len)
+#include <unistd.h>
+#include <errno.h>
+#elif defined(_WIN32)
+#define JSON_FD
+#define JSON_FD_WRITE(fd, data, len) _write(fd, data, (unsigned)(len))
+#include <io.h>
+#include <errno.h>
+#endif
 
 // errors + debugging ==========================================================
 
@@ -127,8 +430,18 @@ json_object_t *json_copy(json_t *, json_object_t *);
         exit(-1);\
     } while (0)
 
+// when ctx->error is set, parse errors are stored there and jump back to where
+// they are caught instead of exiting
 #define JSON_CTX_ERROR(ctx, ...)\
     do {\
+        if ((ctx)->error) {\
+            snprintf(\
+                (ctx)->error->message,\
+                sizeof((ctx)->error->message),\
+                __VA_ARGS__\
+            );\
+            json_ctx_throw(ctx);\
+        }\
         fprintf(stderr, "JSON ERROR: ");\
         fprintf(stderr, __VA_ARGS__);\
         json_contextual_error(ctx);\
@@ -144,14 +457,53 @@ static const char *json_types[] = {
     "JSON_NUMBER",
     "JSON_TRUE",
     "JSON_FALSE",
-    "JSON_NULL"
+    "JSON_NULL",
+    "JSON_INTEGER"
 };
 #endif
 
+typedef enum json_state {
+    JSON_STATE_ROOT, // expecting the root object or array
+    JSON_STATE_VALUE, // expecting a value to fill in
+    JSON_STATE_OPENED, // expecting a container's first item or its end
+    JSON_STATE_KEY, // expecting an object key
+    JSON_STATE_COLON, // expecting ':' after a key
+    JSON_STATE_NEXT, // expecting ',' or the end of a container
+    JSON_STATE_END, // expecting the end of the text
+    JSON_STATE_DONE
+} json_state_e;
+
 typedef struct json_ctx {
     json_t *json;
+    const json_allocator_t *allocator; // json's, or the default without one
     const char *text;
-    size_t index;
+    size_t index, len;
+
+    struct json_index *idx; // structural index, NULL to scan byte by byte
+    bool insitu; // decode strings into text rather than the json_t pages
+
+    // if set, errors are caught (see JSON_CTX_ERROR)
+    json_error_t *error;
+    jmp_buf *jmp;
+
+    // parsing a single value out of a larger text, which is done as soon as the
+    // value is rather than at the null terminator
+    bool embedded;
+    bool lazy; // skip nested objects and arrays, see json_load_lazy()
+    // containers around the text, when it is part of a lazy one
+    size_t base_depth;
+    // the lengths of the containers in the text which are already known, see
+    // json_lazy_container()
+    const struct json_lazy_span *spans;
+    size_t span_count;
+
+    // parser state
+    json_state_e state;
+    json_object_t *object; // value being parsed
+    struct json_frame *stack; // fat pointer, open containers
+    size_t depth, stack_cap;
+    struct json_item *items; // fat pointer, values of the open containers
+    size_t item_count, item_cap;
 } json_ctx_t;
 
 static void json_contextual_error(json_ctx_t *ctx) {
@@ -169,7 +521,7 @@ static void json_contextual_error(json_ctx_t *ctx) {
     size_t i = line_index;
     int line_length = 0;
 
-    while (ctx->text[i] != '\n' && ctx->text[i] != '\0') {
+    while (i < ctx->len && ctx->text[i] != '\n' && ctx->text[i] != '\0') {
         ++line_length;
         ++i;
     }
@@ -179,6 +531,38 @@ static void json_contextual_error(json_ctx_t *ctx) {
     printf("%6s | %*s\n", "", (int)(ctx->index - line_index) + 1, "^");
 }
 
+// stores the line and column of text[index] in error
+static void json_error_locate(
+    json_error_t *error, const char *text, size_t index
+) {
+    size_t line_index = 0;
+
+    error->offset = index;
+    error->line = 1;
+
+    for (size_t i = 0; i < index; ++i) {
+        if (text[i] == '\n') {
+            ++error->line;
+            line_index = i + 1;
+        }
+    }
+
+    error->column = index - line_index + 1;
+}
+
+static void json_ctx_throw(json_ctx_t *ctx) {
+    json_error_t *error = ctx->error;
+    size_t length = strlen(error->message);
+
+    // messages are written for printing
+    if (length && error->message[length - 1] == '\n')
+        error->message[length - 1] = '\0';
+
+    json_error_locate(error, ctx->text, ctx->index);
+
+    longjmp(*ctx->jmp, 1);
+}
+
 // memory ======================================================================
 
 #ifndef JSON_MALLOC
@@ -188,164 +572,220 @@ static void json_contextual_error(json_ctx_t *ctx) {
 #define JSON_FREE(ptr) free(ptr)
 #endif
 
-// size of fread() buffer
+// initial fread() buffer size for files which don't report their size
 #ifndef JSON_FREAD_BUF_SIZE
 #define JSON_FREAD_BUF_SIZE 4096
 #endif
 
-// size of each json_t allocator page, increasing this results pretty directly
-// in less cache misses
+// size of the first json_t allocator page when there's no size hint
 #ifndef JSON_PAGE_SIZE
 #define JSON_PAGE_SIZE 65536
 #endif
 
+// each page added is twice the size of the last, up to this
+#ifndef JSON_MAX_PAGE_SIZE
+#define JSON_MAX_PAGE_SIZE ((size_t)1 << 24)
+#endif
+
+// parsed json takes roughly 3 to 15 times the space of its text, the first
+// page is sized for the low end of that
+#define JSON_HINT_RATIO 4
+#define JSON_MIN_PAGE_SIZE 1024
+
+// number of allocator pages json_reset() keeps allocated for the next parse
+#ifndef JSON_WARM_PAGES
+#define JSON_WARM_PAGES 16
+#endif
+
+// alignment of json_page_alloc() allocations
+#define JSON_PAGE_ALIGN sizeof(void *)
+
 // initial sizes of stretchy buffers for json_t allocators
 #define JSON_INIT_PAGE_CAP 8
-#define JSON_INIT_TRACKED_CAP 256
 
-// tracked pointer header
-typedef struct json_tptr {
-    size_t size, index;
-} json_tptr_t;
+static void *json_default_alloc(void *user, size_t size) {
+    (void)user;
+
+    return JSON_MALLOC(size);
+}
+
+static void json_default_free(void *user, void *ptr) {
+    (void)user;
+
+    JSON_FREE(ptr);
+}
+
+// used by anything that isn't allocating for a json_t
+static const json_allocator_t json_default_allocator = {
+    json_default_alloc, json_default_free, NULL, NULL
+};
 
-// fat functions use fat pointers to track memory allocation with JSON_MALLOC
-// and JSON_FREE. this is useful for allocating things that aren't on a json_t
-// allocator
-static void *json_fat_alloc(size_t size) {
-    size_t *ptr = (size_t *)JSON_MALLOC(sizeof(*ptr) + size);
+// fat functions use fat pointers to track memory allocation through an
+// allocator. this is useful for allocating things that aren't on a json_t's
+// pages
+static void *json_fat_alloc(const json_allocator_t *a, size_t size) {
+    size_t *ptr = (size_t *)a->alloc(a->user, sizeof(*ptr) + size);
 
     *ptr++ = size;
 
     return ptr;
 }
 
-static inline void json_fat_free(void *ptr) {
-    JSON_FREE((size_t *)ptr - 1);
+static inline void json_fat_free(const json_allocator_t *a, void *ptr) {
+    a->free(a->user, (size_t *)ptr - 1);
+}
+
+static inline size_t json_fat_size(void *ptr) {
+    return *((size_t *)ptr - 1);
 }
 
-static void *json_fat_realloc(void *ptr, size_t size) {
-    void *new_ptr = json_fat_alloc(size);
+static void *json_fat_realloc(
+    const json_allocator_t *a, void *ptr, size_t size
+) {
+    if (ptr && a->realloc) {
+        size_t *base = (size_t *)a->realloc(
+            a->user, (size_t *)ptr - 1, sizeof(*base) + size
+        );
+
+        *base++ = size;
+
+        return base;
+    }
+
+    void *new_ptr = json_fat_alloc(a, size);
 
     if (ptr) {
         // copy min(old_size, new_size)
-        size_t copy_size = *((size_t *)ptr - 1);
+        size_t copy_size = json_fat_size(ptr);
 
         if (copy_size > size)
             copy_size = size;
 
         memcpy(new_ptr, ptr, copy_size);
-        json_fat_free(ptr);
+        json_fat_free(a, ptr);
     }
 
     return new_ptr;
 }
 
-static void *json_tracked_alloc(json_t *json, size_t size) {
-    // allocate tracked pointer
-    json_tptr_t *tptr = (json_tptr_t *)JSON_MALLOC(sizeof(*tptr) + size);
+// size of the page added after one of size bytes
+static size_t json_page_next_size(json_t *json, size_t size) {
+    return size < json->page_max >> 1 ? size << 1 : json->page_max;
+}
 
-    tptr->size = size;
-    tptr->index = json->cur_tracked++;
+// pushes a new page of at least size bytes. pages are fat pointers, so warm
+// pages kept by json_reset() know their size
+static void json_page_push(json_t *json, size_t size) {
+    if (size < json->page_grow)
+        size = json->page_grow;
 
-    // push tracked pointer on tracked array
-    if (json->cur_tracked == json->tracked_cap) {
-        size_t old_cap = json->tracked_cap;
+    json->page_grow = json_page_next_size(json, json->page_grow);
 
-        json->tracked_cap <<= 1;
-        json->tracked = (json_tptr_t **)json_fat_realloc(
-            json->tracked,
-            json->tracked_cap * sizeof(*json->tracked)
+    if (++json->cur_page == json->page_cap) {
+        json->page_cap <<= 1;
+        json->pages = (char **)json_fat_realloc(
+            &json->allocator,
+            json->pages,
+            json->page_cap * sizeof(*json->pages)
         );
+    }
+
+    char **page = &json->pages[json->cur_page];
+
+    if (json->cur_page < json->page_count) {
+        // reuse the warm page unless it's too small
+        if (json_fat_size(*page) < size) {
+            json_fat_free(&json->allocator, *page);
+            *page = (char *)json_fat_alloc(&json->allocator, size);
+        }
+    } else {
+        JSON_DEBUG("allocating new page.\n");
 
-        for (size_t i = old_cap; i < json->tracked_cap; ++i)
-            json->tracked[i] = NULL;
+        *page = (char *)json_fat_alloc(&json->allocator, size);
+        ++json->page_count;
     }
 
-    json->tracked[tptr->index] = tptr;
+    json->page_size = json_fat_size(*page);
+    json->used = 0;
+}
+
+// returns at least size free bytes at the top of the current page without
+// allocating them, for data whose final size isn't known up front. claim the
+// bytes actually used with json_page_commit()
+static char *json_page_reserve(json_t *json, size_t size) {
+    if (json->used + size > json->page_size)
+        json_page_push(json, size);
 
-    JSON_DEBUG("tracked alloc %zu.\n", tptr->index);
+    return json->pages[json->cur_page] + json->used;
+}
 
-    return tptr + 1;
+static inline void json_page_commit(json_t *json, size_t size) {
+    json->used += size;
 }
 
-static void json_tracked_free(json_t *json, void *ptr) {
-    size_t index = ((json_tptr_t *)ptr - 1)->index;
+// allocates on a json_t page, aligned for any of the json data structures
+static void *json_page_alloc(json_t *json, size_t size) {
+    // strings are packed unaligned, so realign after them
+    json->used = (json->used + JSON_PAGE_ALIGN - 1) & ~(JSON_PAGE_ALIGN - 1);
 
-    JSON_FREE(json->tracked[index]);
+    void *ptr = json_page_reserve(json, size);
 
-    json->tracked[index] = NULL;
+    json_page_commit(json, size);
 
-    JSON_DEBUG("tracked free %zu.\n", index);
+    return ptr;
 }
 
-// does NOT handle null pointers
-static void *json_tracked_realloc(json_t *json, void *ptr, size_t size) {
-    JSON_ASSERT(ptr, "json_tracked_realloc doesn't support null pointers.\n");
+// container storage, which grows and shrinks, is allocated in power of 2 sized
+// blocks on the pages. each block is preceded by its size class, and freed
+// blocks are kept on json->free_blocks for the next block of the same class
+#define JSON_BLOCK_MIN_CLASS 4
 
-    // allocate new tracked pointer
-    json_tptr_t *old_tptr = (json_tptr_t *)ptr - 1;
-    json_tptr_t *new_tptr = (json_tptr_t *)JSON_MALLOC(
-        sizeof(*new_tptr) + size
-    );
+static void *json_block_alloc(json_t *json, size_t size) {
+    size_t size_class = JSON_BLOCK_MIN_CLASS;
 
-    new_tptr->size = size;
-    new_tptr->index = old_tptr->index;
+    while (((size_t)1 << size_class) < size)
+        ++size_class;
 
-    // copy data
-    size_t copy_size = old_tptr->size > new_tptr->size
-        ? new_tptr->size : old_tptr->size;
+    void *ptr = json->free_blocks[size_class];
 
-    memcpy(new_tptr + 1, ptr, copy_size);
+    if (ptr) {
+        json->free_blocks[size_class] = *(void **)ptr;
 
-    // replace old_tptr in tracked array
-    JSON_FREE(old_tptr);
+        return ptr;
+    }
 
-    json->tracked[new_tptr->index] = new_tptr;
+    size_t *block = (size_t *)json_page_alloc(
+        json,
+        sizeof(*block) + ((size_t)1 << size_class)
+    );
 
-    JSON_DEBUG("tracked realloc %zu.\n", new_tptr->index);
+    *block = size_class;
 
-    return new_tptr + 1;
+    return block + 1;
 }
 
-// allocates on a json_t page
-static void *json_page_alloc(json_t *json, size_t size) {
-    // allocate new page when needed
-    if (json->used + size > JSON_PAGE_SIZE) {
-        if (size >= JSON_PAGE_SIZE) {
-            JSON_DEBUG("allocating custom page and new page.\n");
-
-            // size too big for pages, give this pointer its own page
-            json->pages[++json->cur_page] = (char *)JSON_MALLOC(size);
-
-            void *ptr = json->pages[json->cur_page];
+static void json_block_free(json_t *json, void *ptr) {
+    size_t size_class = *((size_t *)ptr - 1);
 
-            json->pages[++json->cur_page] = (char *)JSON_MALLOC(JSON_PAGE_SIZE);
-            json->used = 0;
+    *(void **)ptr = json->free_blocks[size_class];
+    json->free_blocks[size_class] = ptr;
+}
 
-            return ptr;
-        } else {
-            JSON_DEBUG("allocating new page.\n");
-
-            // allocate new page
-            if (++json->cur_page == json->page_cap) {
-                json->page_cap <<= 1;
-                json->pages = (char **)json_fat_realloc(
-                    json->pages,
-                    json->page_cap * sizeof(*json->pages)
-                );
-            }
+static void *json_block_realloc(json_t *json, void *ptr, size_t size) {
+    size_t size_class = *((size_t *)ptr - 1);
+    size_t old_size = (size_t)1 << size_class;
 
-            json->pages[json->cur_page] = (char *)JSON_MALLOC(JSON_PAGE_SIZE);
-            json->used = 0;
-        }
-    }
+    // still fits and wouldn't fit in a smaller class
+    if (size <= old_size && (size << 1 > old_size
+     || size_class == JSON_BLOCK_MIN_CLASS))
+        return ptr;
 
-    // return page space
-    void *ptr = json->pages[json->cur_page] + json->used;
+    void *new_ptr = json_block_alloc(json, size);
 
-    json->used += size;
+    memcpy(new_ptr, ptr, size < old_size ? size : old_size);
+    json_block_free(json, ptr);
 
-    return ptr;
+    return new_ptr;
 }
 
 // array (vector) ==============================================================
@@ -353,14 +793,14 @@ static void *json_page_alloc(json_t *json, size_t size) {
 #define JSON_VEC_INIT_CAP 8
 
 typedef struct json_vec {
-    void **data; // fat ptr
+    void **data; // block
     size_t size, cap, min_cap;
 } json_vec_t;
 
 static void json_vec_alloc_one(json_t *json, json_vec_t *vec) {
     if (vec->size + 1 > vec->cap) {
-        vec->cap <<= 1;
-        vec->data = (void **)json_tracked_realloc(
+        vec->cap = vec->cap ? vec->cap << 1 : JSON_VEC_INIT_CAP;
+        vec->data = (void **)json_block_realloc(
             json,
             vec->data,
             vec->cap * sizeof(*vec->data)
@@ -373,7 +813,7 @@ static void json_vec_free_one(json_t *json, json_vec_t *vec) {
 
     if (vec->cap > vec->min_cap && vec->size < vec->cap >> 2) {
         vec->cap >>= 1;
-        vec->data = (void **)json_tracked_realloc(
+        vec->data = (void **)json_block_realloc(
             json,
             vec->data,
             vec->cap * sizeof(*vec->data)
@@ -387,7 +827,7 @@ static void json_vec_make(json_t *json, json_vec_t *vec, size_t init_cap) {
     vec->size = 0;
     vec->min_cap = vec->cap = init_cap;
 
-    vec->data = (void **)json_tracked_alloc(
+    vec->data = (void **)json_block_alloc(
         json,
         vec->cap * sizeof(*vec->data)
     );
@@ -412,8 +852,10 @@ static void *json_vec_del(json_t *json, json_vec_t *vec, size_t index) {
     );
 
     void *item = vec->data[index];
+    // popping can shrink data, so it has to happen before indexing into it
+    void *last = json_vec_pop(json, vec);
 
-    vec->data[index] = json_vec_pop(json, vec);
+    vec->data[index] = last;
 
     return item;
 }
@@ -428,7 +870,7 @@ static void *json_vec_del_ordered(
 
     void *item = vec->data[index];
 
-    memcpy(
+    memmove(
         vec->data + index,
         vec->data + index + 1,
         (vec->size - index - 1)  * sizeof(*vec->data)
@@ -455,30 +897,40 @@ typedef uint32_t json_hash_t;
 #define JSON_FNV_BASIS 0x0811c9dc5
 #endif
 
-typedef struct json_hnode {
+// the hmap keeps its keys in insertion order in vec, with each key's object,
+// length and hash in the parallel entries array. nodes is an open addressing
+// table (linear probing, power of 2 capacity) of indices into the entries
+typedef struct json_hentry {
     json_object_t *object;
+    size_t key_len;
     json_hash_t hash;
-    size_t index, steps;
+} json_hentry_t;
+
+typedef struct json_hnode {
+    json_hash_t hash; // zero if empty
+    size_t entry;
 } json_hnode_t;
 
 typedef struct json_hmap {
     json_vec_t vec; // stores keys in order
-    json_hnode_t *nodes; // fat ptr
-    size_t size, cap, min_cap;
+    json_hentry_t *entries; // block, same cap as vec
+    json_hnode_t *nodes; // block
+    size_t cap, min_cap;
 } json_hmap_t;
 
 // fnv-1a hash function (http://isthe.com/chongo/tech/comp/fnv/)
-static json_hash_t json_hash_str(char *str) {
+static json_hash_t json_hash_str(const char *str, size_t len) {
     json_hash_t hash = JSON_FNV_BASIS;
 
-    while (*str)
-        hash = (hash ^ *str++) * JSON_FNV_PRIME;
+    for (size_t i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char)str[i]) * JSON_FNV_PRIME;
 
-    return hash;
+    // zero marks empty nodes
+    return hash ? hash : 1;
 }
 
 static json_hnode_t *json_hnodes_alloc(json_t *json, size_t num_nodes) {
-    json_hnode_t *nodes = (json_hnode_t *)json_tracked_alloc(
+    json_hnode_t *nodes = (json_hnode_t *)json_block_alloc(
         json,
         num_nodes * sizeof(*nodes)
     );
@@ -489,632 +941,3690 @@ static json_hnode_t *json_hnodes_alloc(json_t *json, size_t num_nodes) {
     return nodes;
 }
 
-static bool json_hmap_put_node(json_t *, json_hmap_t *, json_hnode_t *);
+static void json_hmap_insert_node(
+    json_hmap_t *hmap, json_hash_t hash, size_t entry
+) {
+    size_t mask = hmap->cap - 1;
+    size_t index = hash & mask;
+
+    while (hmap->nodes[index].hash)
+        index = (index + 1) & mask;
+
+    hmap->nodes[index].hash = hash;
+    hmap->nodes[index].entry = entry;
+}
 
+// rebuild the node table from the entries
 static void json_hmap_rehash(json_t *json, json_hmap_t *hmap, size_t new_cap) {
-    json_hnode_t *old_nodes = hmap->nodes;
-    size_t old_cap = hmap->cap;
+    json_block_free(json, hmap->nodes);
 
     hmap->cap = new_cap;
     hmap->nodes = json_hnodes_alloc(json, hmap->cap);
-    hmap->size = 0;
 
-    for (size_t i = 0; i < old_cap; ++i) {
-        if (old_nodes[i].hash) {
-            old_nodes[i].index = old_nodes[i].hash % hmap->cap;
-            old_nodes[i].steps = 0;
+    for (size_t i = 0; i < hmap->vec.size; ++i)
+        json_hmap_insert_node(hmap, hmap->entries[i].hash, i);
+}
 
-            json_hmap_put_node(json, hmap, &old_nodes[i]);
-        }
+// keep entries the same capacity as the key vec after it resizes
+static void json_hmap_sync_entries(
+    json_t *json, json_hmap_t *hmap, size_t old_cap
+) {
+    if (hmap->vec.cap != old_cap) {
+        hmap->entries = (json_hentry_t *)json_block_realloc(
+            json,
+            hmap->entries,
+            hmap->vec.cap * sizeof(*hmap->entries)
+        );
     }
-
-    json_tracked_free(json, old_nodes);
 }
 
-static inline void json_hmap_alloc_slot(json_t *json, json_hmap_t *hmap) {
-    if (hmap->size + 1 > hmap->cap >> 1)
-        json_hmap_rehash(json, hmap, hmap->cap << 1);
-
-    ++hmap->size;
-}
+// makes room for init_cap entries without growing
+static void json_hmap_make(json_t *json, json_hmap_t *hmap, size_t init_cap) {
+    json_vec_make(json, &hmap->vec, init_cap);
 
-static inline void json_hmap_free_slot(json_t *json, json_hmap_t *hmap) {
-    if (hmap->size < hmap->cap >> 2 && hmap->cap > hmap->min_cap)
-        json_hmap_rehash(json, hmap, hmap->cap >> 1);
+    hmap->entries = (json_hentry_t *)json_block_alloc(
+        json,
+        hmap->vec.cap * sizeof(*hmap->entries)
+    );
 
-    --hmap->size;
-}
+    // smallest power of 2 which keeps the load factor at or below 1/2
+    hmap->cap = 1;
 
-static void json_hmap_make(json_t *json, json_hmap_t *hmap, size_t init_cap) {
-    json_vec_make(json, &hmap->vec, init_cap);
+    while (hmap->cap >> 1 < init_cap)
+        hmap->cap <<= 1;
 
-    hmap->size = 0;
-    hmap->cap = hmap->min_cap = init_cap;
+    hmap->min_cap = hmap->cap;
     hmap->nodes = json_hnodes_alloc(json, hmap->cap);
 }
 
-static json_hnode_t *json_hmap_get_node(json_hmap_t *hmap, json_hash_t hash) {
-    size_t index = hash % hmap->cap;
+// returns node matching key, or NULL
+static json_hnode_t *json_hmap_get_node(
+    json_hmap_t *hmap, const char *key, size_t key_len, json_hash_t hash
+) {
+    size_t mask = hmap->cap - 1;
+    size_t index = hash & mask;
 
     // iterate through hash chain until match or empty node is found
     while (hmap->nodes[index].hash) {
-        if (hmap->nodes[index].hash == hash)
-            return &hmap->nodes[index];
+        json_hnode_t *node = &hmap->nodes[index];
+
+        if (node->hash == hash
+         && hmap->entries[node->entry].key_len == key_len
+         && !memcmp(hmap->vec.data[node->entry], key, key_len))
+            return node;
 
-        index = (index + 1) % hmap->cap;
+        index = (index + 1) & mask;
     }
 
     return NULL;
 }
 
-// for rehash + put
-// returns whether a previous node has been replaced
-static bool json_hmap_put_node(
-    json_t *json, json_hmap_t *hmap, json_hnode_t *node
+static void json_hmap_put(
+    json_t *json, json_hmap_t *hmap, char *key, size_t key_len,
+    json_object_t *object
 ) {
-    size_t index = node->index;
-
-    // find suitable bucket
-    while (hmap->nodes[index].hash) {
-        if (hmap->nodes[index].hash == node->hash) {
-            // found matching bucket
-            hmap->nodes[index].object = node->object;
-            return true;
-        }
+    json_hash_t hash = json_hash_str(key, key_len);
+    json_hnode_t *node = json_hmap_get_node(hmap, key, key_len, hash);
 
-        index = (index + 1) % hmap->cap;
-        ++node->steps;
+    if (node) {
+        // replace existing value
+        hmap->entries[node->entry].object = object;
+        return;
     }
 
-    // found empty bucket
-    hmap->nodes[index] = *node;
-    json_hmap_alloc_slot(json, hmap);
-
-    return false;
-}
+    // keep load factor at or below 1/2
+    if (hmap->vec.size + 1 > hmap->cap >> 1)
+        json_hmap_rehash(json, hmap, hmap->cap << 1);
 
-static void json_hmap_put(
-    json_t *json, json_hmap_t *hmap, char *key, json_object_t *object
-) {
-    json_hnode_t node;
+    // add new entry
+    size_t old_cap = hmap->vec.cap;
+    size_t entry = hmap->vec.size;
 
-    node.object = object;
-    node.hash = json_hash_str(key);
-    node.index = node.hash % hmap->cap;
+    json_vec_push(json, &hmap->vec, key);
+    json_hmap_sync_entries(json, hmap, old_cap);
 
-    if (!json_hmap_put_node(json, hmap, &node))
-        json_vec_push(json, &hmap->vec, key);
+    hmap->entries[entry].object = object;
+    hmap->entries[entry].key_len = key_len;
+    hmap->entries[entry].hash = hash;
 
+    json_hmap_insert_node(hmap, hash, entry);
 }
 
-static json_object_t *json_hmap_get(json_hmap_t *hmap, char *key) {
-    json_hnode_t *node = json_hmap_get_node(hmap, json_hash_str(key));
+static json_object_t *json_hmap_get(
+    json_hmap_t *hmap, const char *key, size_t key_len
+) {
+    json_hnode_t *node = json_hmap_get_node(
+        hmap,
+        key,
+        key_len,
+        json_hash_str(key, key_len)
+    );
 
-    return node ? node->object : NULL;
+    return node ? hmap->entries[node->entry].object : NULL;
 }
 
 static json_object_t *json_hmap_del(
-    json_t *json, json_hmap_t *hmap, char *key, bool order
+    json_t *json, json_hmap_t *hmap, const char *key, size_t key_len,
+    bool order
 ) {
-    json_hash_t hash = json_hash_str(key);
-    size_t index = hash % hmap->cap;
+    json_hnode_t *node = json_hmap_get_node(
+        hmap,
+        key,
+        key_len,
+        json_hash_str(key, key_len)
+    );
 
-    // find node
-    while (hmap->nodes[index].hash != hash) {
-        if (!hmap->nodes[index].hash)
-            return NULL; // node doesn't exist
+    if (!node)
+        return NULL; // node doesn't exist
 
-        index = (index + 1) % hmap->cap;
-    }
+    size_t entry = node->entry;
+    json_object_t *object = hmap->entries[entry].object;
 
-    json_object_t *object = hmap->nodes[index].object;
+    // remove node, shifting back any following nodes in the chain which would
+    // no longer be reachable from their home bucket
+    size_t mask = hmap->cap - 1;
+    size_t hole = (size_t)(node - hmap->nodes), index = hole;
 
-    // replace chain
-    size_t last = index, steps = 0;
+    while (hmap->nodes[index = (index + 1) & mask].hash) {
+        size_t home = hmap->nodes[index].hash & mask;
 
-    while (hmap->nodes[index = (index + 1) % hmap->cap].hash) {
-        if (hmap->nodes[index].steps >= ++steps) {
-            // found node that is a valid chain replacement
-            hmap->nodes[last] = hmap->nodes[index];
-            hmap->nodes[last].steps -= steps;
-            last = index;
-            steps = 0;
+        if (((index - home) & mask) >= ((index - hole) & mask)) {
+            hmap->nodes[hole] = hmap->nodes[index];
+            hole = index;
         }
     }
 
-    // last node in chain is now a duplicate
-    hmap->nodes[last].hash = 0;
-    json_hmap_free_slot(json, hmap);
+    hmap->nodes[hole].hash = 0;
 
-    // remove key from vec
-    for (size_t i = 0; i < hmap->vec.size; ++i) {
-        if (!strcmp(key, (char *)hmap->vec.data[i])) {
-            if (order)
-                json_vec_del_ordered(json, &hmap->vec, i);
-            else
-                json_vec_del(json, &hmap->vec, i);
+    // remove entry
+    size_t old_cap = hmap->vec.cap;
+    size_t last = hmap->vec.size - 1;
 
-            break;
+    if (order) {
+        memmove(
+            hmap->entries + entry,
+            hmap->entries + entry + 1,
+            (last - entry) * sizeof(*hmap->entries)
+        );
+
+        for (size_t i = 0; i < hmap->cap; ++i)
+            if (hmap->nodes[i].hash && hmap->nodes[i].entry > entry)
+                --hmap->nodes[i].entry;
+
+        json_vec_del_ordered(json, &hmap->vec, entry);
+    } else {
+        if (entry != last) {
+            // last entry moves into the removed one's place
+            hmap->entries[entry] = hmap->entries[last];
+
+            index = hmap->entries[entry].hash & mask;
+
+            while (hmap->nodes[index].entry != last
+                || !hmap->nodes[index].hash)
+                index = (index + 1) & mask;
+
+            hmap->nodes[index].entry = entry;
         }
+
+        json_vec_del(json, &hmap->vec, entry);
     }
 
+    json_hmap_sync_entries(json, hmap, old_cap);
+
+    if (hmap->vec.size < hmap->cap >> 2 && hmap->cap > hmap->min_cap)
+        json_hmap_rehash(json, hmap, hmap->cap >> 1);
+
     return object;
 }
 
-// parsing =====================================================================
+// structural index ============================================================
 
-// for mapping escape sequences
-#define JSON_ESCAPE_CHARACTERS_X\
-    X('"', '\"')\
-    X('\\', '\\')\
-    X('/', '/')\
-    X('b', '\b')\
-    X('f', '\f')\
-    X('n', '\n')\
-    X('r', '\r')\
-    X('t', '\t')
+// parsing happens in two stages. stage 1 classifies the text in 64 byte blocks
+// and records the position of every structural character, string and scalar
+// that isn't inside of a string. stage 2 (the parser) then jumps between these
+// positions rather than stepping over whitespace one byte at a time.
+//
+// the index is built one window at a time as the parser consumes it, which
+// keeps the positions buffer small and warm in cache.
 
-static bool json_is_whitespace(char ch) {
-    switch (ch) {
-    case 0x20:
-    case 0x0A:
-    case 0x0D:
-    case 0x09:
-        return true;
-    default:
-        return false;
-    }
-}
+// bytes of text indexed per window, must be a multiple of JSON_BLOCK_SIZE
+#ifndef JSON_INDEX_WINDOW
+#define JSON_INDEX_WINDOW 65536
+#endif
 
-static inline bool json_is_digit(char ch) {
-    return ch >= '0' && ch <= '9';
-}
+// texts shorter than this are parsed without an index, skipping whitespace
+// directly
+#ifndef JSON_INDEX_MIN
+#define JSON_INDEX_MIN 4096
+#endif
 
-// skip whitespace to start of next token
-static void json_next_token(json_ctx_t *ctx) {
-    while (1) {
-        if (!json_is_whitespace(ctx->text[ctx->index]))
-            return;
+#define JSON_BLOCK_SIZE 64
 
-        ++ctx->index;
-    }
-}
+typedef struct json_index {
+    uint32_t *positions; // offsets from base
+    size_t base, count, cur;
+    size_t scanned; // number of text bytes classified so far
 
-// compare next token with passed token
-static bool json_token_equals(
-    json_ctx_t *ctx, const char *token, size_t length
-) {
-    for (size_t i = 0; i < length; ++i)
-        if (ctx->text[ctx->index + i] != token[i])
-            return false;
+    // state carried between blocks
+    uint64_t in_string; // all ones if the last block ended inside a string
+    uint64_t escaped; // 1 if the first char of the next block is escaped
+    uint64_t follows; // 1 if the last char of the last block was a separator
+} json_index_t;
 
-    return true;
+// character classes of a block, bit i describes char i
+typedef struct json_block {
+    uint64_t quote, backslash, whitespace, structural;
+} json_block_t;
+
+static inline int json_ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+
+    while (!(x & 1)) {
+        x >>= 1;
+        ++n;
+    }
+
+    return n;
+#endif
 }
 
-// error if next token does not equal passed token, otherwise skip
-static void json_expect_token(
-    json_ctx_t *ctx, const char *token, size_t length
-) {
-    if (!json_token_equals(ctx, token, length))
-        JSON_CTX_ERROR(ctx, "unknown token, expected \"%s\".\n", token);
+// bit i of the result is the xor of bits 0 through i
+static inline uint64_t json_prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
 
-    ctx->index += length;
+    return x;
 }
 
-// error if next character is not a valid json string character, otherwise
-// return char and skip
-static char json_expect_str_char(json_ctx_t *ctx) {
-    if (ctx->text[ctx->index] == '\\') {
-        // escape codes
-        char ch;
+#if defined(JSON_AVX2)
+
+static void json_classify_block(const char *text, json_block_t *block) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    block->quote = block->backslash = 0;
+    block->whitespace = block->structural = 0;
+
+    for (int i = 0; i < JSON_BLOCK_SIZE; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(text + i));
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))
+            ),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))
+            )
+        );
+        __m256i st = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')),
+                _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))
+            ),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))
+            )
+        );
 
-        switch (ctx->text[++ctx->index]) {
-#define X(a, b) case a: ch = b; break;
-        JSON_ESCAPE_CHARACTERS_X
-#undef X
-        case 'u':
-            JSON_CTX_ERROR(
-                ctx,
-                "ghh_json does not support unicode escape sequences currently."
-                "\n"
-            );
-        default:
-            JSON_CTX_ERROR(
-                ctx,
-                "unknown character escape: '%c' (%hhX)\n",
-                ctx->text[ctx->index], ctx->text[ctx->index]
-            );
-        }
+        block->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(v, quote)
+        ) << i;
+        block->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(v, backslash)
+        ) << i;
+        block->whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << i;
+        block->structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(st) << i;
+    }
+}
 
-        ++ctx->index;
+#elif defined(JSON_SSE2)
+
+static void json_classify_block(const char *text, json_block_t *block) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    block->quote = block->backslash = 0;
+    block->whitespace = block->structural = 0;
+
+    for (int i = 0; i < JSON_BLOCK_SIZE; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(text + i));
+        // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))
+            ),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))
+            )
+        );
+        __m128i st = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(lower, _mm_set1_epi8('{')),
+                _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))
+            ),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(','))
+            )
+        );
 
-        return ch;
-    } else {
-        // raw character
-        return ctx->text[ctx->index++];
+        block->quote |= (uint64_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(v, quote)
+        ) << i;
+        block->backslash |= (uint64_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(v, backslash)
+        ) << i;
+        block->whitespace |= (uint64_t)_mm_movemask_epi8(ws) << i;
+        block->structural |= (uint64_t)_mm_movemask_epi8(st) << i;
     }
 }
 
-// return string allocated on ctx allocator if valid string, otherwise error
-static char *json_expect_string(json_ctx_t *ctx) {
-    // verify string and count string length
-    if (ctx->text[ctx->index++] != '\"')
-        JSON_CTX_ERROR(ctx, "unknown token, expected string.\n");
+#else
 
-    size_t start_index = ctx->index;
-    size_t length = 0;
+static void json_classify_block(const char *text, json_block_t *block) {
+    block->quote = block->backslash = 0;
+    block->whitespace = block->structural = 0;
 
-    while (ctx->text[ctx->index] != '\"') {
-        switch (ctx->text[ctx->index]) {
-        default:
-            json_expect_str_char(ctx);
-            ++length;
+    for (int i = 0; i < JSON_BLOCK_SIZE; ++i) {
+        uint64_t bit = (uint64_t)1 << i;
 
+        switch (text[i]) {
+        case '"':
+            block->quote |= bit;
+            break;
+        case '\\':
+            block->backslash |= bit;
             break;
+        case ' ':
         case '\n':
-        case '\0':
-            JSON_CTX_ERROR(ctx, "string ended unexpectedly.\n");
+        case '\r':
+        case '\t':
+            block->whitespace |= bit;
+            break;
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ':':
+        case ',':
+            block->structural |= bit;
+            break;
+        default:
+            break;
         }
     }
+}
 
-    // read string
-    char *str = (char *)json_page_alloc(ctx->json, (length + 1) * sizeof(*str));
+#endif
 
-    ctx->index = start_index;
+// returns the mask of token starts in a block and updates carried state
+static uint64_t json_index_block(json_index_t *idx, const json_block_t *block) {
+    // find escaped characters. backslashes are rare in practice, so walking
+    // them one at a time is cheaper than doing it branchlessly
+    uint64_t escaped = idx->escaped;
+    uint64_t backslash = block->backslash;
 
-    for (size_t i = 0; i < length; ++i)
-        str[i] = json_expect_str_char(ctx);
+    idx->escaped = 0;
 
-    str[length] = '\0';
+    while (backslash) {
+        uint64_t bit = backslash & (~backslash + 1);
 
-    ++ctx->index; // skip ending double quote
+        if (!(escaped & bit)) {
+            if (bit >> 63)
+                idx->escaped = 1;
+            else
+                escaped |= bit << 1;
+        }
 
-    return str;
-}
+        backslash &= backslash - 1;
+    }
 
-static double json_expect_number(json_ctx_t *ctx) {
-    size_t start_index = ctx->index;
+    // string interiors, including opening quotes but not closing quotes
+    uint64_t quotes = block->quote & ~escaped;
+    uint64_t in_string = json_prefix_xor(quotes) ^ idx->in_string;
 
-    // minus symbol
-    if (ctx->text[ctx->index] == '-')
-        ++ctx->index;
+    idx->in_string = 0 - (in_string >> 63);
 
-    // integral component
-    if (!json_is_digit(ctx->text[ctx->index]))
-        JSON_CTX_ERROR(ctx, "expected digit.\n");
+    // a scalar starts wherever a non-separator follows a separator
+    uint64_t structural = block->structural & ~in_string;
+    uint64_t separator = (block->whitespace & ~in_string) | structural;
+    uint64_t scalar = ~(separator | quotes | in_string);
+    uint64_t follows = (separator << 1) | idx->follows;
 
-    while (json_is_digit(ctx->text[ctx->index])) {
-        ++ctx->index;
-    }
+    idx->follows = separator >> 63;
 
-    // fractional component
-    if (ctx->text[ctx->index] == '.') {
-        ++ctx->index;
+    return structural | (quotes & in_string) | (scalar & follows);
+}
 
-        if (!json_is_digit(ctx->text[ctx->index]))
-            JSON_CTX_ERROR(ctx, "expected digit.\n");
+// positions is the index's buffer, it is taken from the json_t's scratch if
+// there is one
+static void json_index_make(json_ctx_t *ctx) {
+    json_index_t *idx = ctx->idx;
+    json_t *json = ctx->json;
+    const json_allocator_t *a = ctx->allocator;
 
-        while (json_is_digit(ctx->text[ctx->index])) {
-            ++ctx->index;
-        }
+    if (json && json->positions) {
+        idx->positions = json->positions;
+        json->positions = NULL;
+    } else {
+        idx->positions = (uint32_t *)a->alloc(
+            a->user, (JSON_INDEX_WINDOW + 1) * sizeof(*idx->positions)
+        );
     }
 
-    // exponential component
-    if (ctx->text[ctx->index] == 'e' || ctx->text[ctx->index] == 'E') {
-        ++ctx->index;
+    idx->base = idx->count = idx->cur = idx->scanned = 0;
+    idx->in_string = idx->escaped = 0;
+    idx->follows = 1; // start of text acts as a separator
+}
+
+// gives the index's buffer back to the json_t's scratch, and stops indexing
+static void json_index_kill(json_ctx_t *ctx) {
+    json_t *json = ctx->json;
+
+    if (json && !json->positions)
+        json->positions = ctx->idx->positions;
+    else
+        ctx->allocator->free(ctx->allocator->user, ctx->idx->positions);
+
+    ctx->idx = NULL;
+}
+
+// classify the next window of text. when the end of text is reached, its
+// position is added as a sentinel so the parser always finds a next token
+static void json_index_fill(json_ctx_t *ctx) {
+    json_index_t *idx = ctx->idx;
+    size_t end = idx->scanned + JSON_INDEX_WINDOW;
+
+    if (end > ctx->len)
+        end = ctx->len;
+
+    idx->base = idx->scanned;
+    idx->count = idx->cur = 0;
+
+    for (size_t i = idx->scanned; i < end; i += JSON_BLOCK_SIZE) {
+        json_block_t block;
+        uint64_t valid = ~(uint64_t)0;
+
+        if (i + JSON_BLOCK_SIZE <= ctx->len) {
+            json_classify_block(ctx->text + i, &block);
+        } else {
+            // pad the last block with whitespace rather than reading past len
+            char padded[JSON_BLOCK_SIZE];
+
+            memset(padded, ' ', JSON_BLOCK_SIZE);
+            memcpy(padded, ctx->text + i, ctx->len - i);
+
+            json_classify_block(padded, &block);
+            valid = ((uint64_t)1 << (ctx->len - i)) - 1;
+        }
+
+        uint64_t starts = json_index_block(idx, &block) & valid;
+        uint32_t offset = (uint32_t)(i - idx->base);
+
+        while (starts) {
+            idx->positions[idx->count++] = offset + json_ctz64(starts);
+            starts &= starts - 1;
+        }
+    }
+
+    idx->scanned = end;
+
+    if (end == ctx->len)
+        idx->positions[idx->count++] = (uint32_t)(end - idx->base);
+}
+
+// make sure the text up to and including end has been classified, before the
+// parser modifies it. only call this from inside of a string, any positions
+// skipped over are then inside of the string as well
+static void json_index_sync(json_ctx_t *ctx, size_t end) {
+    while (ctx->idx->scanned <= end)
+        json_index_fill(ctx);
+}
+
+// parsing =====================================================================
+
+// for mapping escape sequences
+#define JSON_ESCAPE_CHARACTERS_X\
+    X('"', '\"')\
+    X('\\', '\\')\
+    X('/', '/')\
+    X('b', '\b')\
+    X('f', '\f')\
+    X('n', '\n')\
+    X('r', '\r')\
+    X('t', '\t')
+
+static bool json_is_whitespace(char ch) {
+    switch (ch) {
+    case 0x20:
+    case 0x0A:
+    case 0x0D:
+    case 0x09:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static inline bool json_is_digit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+// returns the length of the run of whitespace at the start of text. avail is
+// the number of bytes that may be read
+static size_t json_whitespace_run(const char *text, size_t avail) {
+    size_t i = 0;
+
+#if defined(JSON_AVX2)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i tab = _mm256_set1_epi8('\t');
+
+    for (; i + 32 <= avail; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, space),
+                _mm256_cmpeq_epi8(v, newline)
+            ),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, cr),
+                _mm256_cmpeq_epi8(v, tab)
+            )
+        );
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(ws);
+
+        if (mask)
+            return i + json_ctz64(mask);
+    }
+#elif defined(JSON_SSE2)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+
+    for (; i + 16 <= avail; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, space),
+                _mm_cmpeq_epi8(v, newline)
+            ),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, cr),
+                _mm_cmpeq_epi8(v, tab)
+            )
+        );
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+
+        if (mask)
+            return i + json_ctz64(mask);
+    }
+#endif
+
+    // swar, skip 8 bytes at a time while they are all whitespace
+    const uint64_t ones = 0x0101010101010101, low = 0x7F7F7F7F7F7F7F7F;
+
+    for (; i + 8 <= avail; i += 8) {
+        uint64_t word, ws = 0;
+
+        memcpy(&word, text + i, sizeof(word));
+
+        // sets the high bit of each byte equal to ch
+#define JSON_SWAR_EQ(ch)\
+        ws |= ~((((word ^ (ones * ch)) & low) + low) | (word ^ (ones * ch)));
+
+        JSON_SWAR_EQ(' ')
+        JSON_SWAR_EQ('\n')
+        JSON_SWAR_EQ('\r')
+        JSON_SWAR_EQ('\t')
+#undef JSON_SWAR_EQ
+
+        if ((ws & ~low) != ~low)
+            break;
+    }
+
+    while (i < avail && json_is_whitespace(text[i]))
+        ++i;
+
+    return i;
+}
+
+static void json_next_token(json_ctx_t *ctx) {
+    json_index_t *idx = ctx->idx;
+
+    if (!json_is_whitespace(ctx->text[ctx->index]))
+        return;
+
+    // single space between tokens
+    if (!json_is_whitespace(ctx->text[ctx->index + 1])) {
+        ++ctx->index;
+        return;
+    }
+
+    if (idx) {
+        // jump to the first indexed position at or after the current index
+        while (1) {
+            const uint32_t *positions = idx->positions;
+            size_t cur = idx->cur, count = idx->count;
+            size_t target = ctx->index > idx->base
+                ? ctx->index - idx->base : 0;
+
+            for (; cur < count; ++cur) {
+                if (positions[cur] >= target) {
+                    idx->cur = cur;
+                    ctx->index = idx->base + positions[cur];
+                    return;
+                }
+            }
+
+            json_index_fill(ctx);
+        }
+    }
+
+    ctx->index += json_whitespace_run(
+        ctx->text + ctx->index,
+        ctx->len - ctx->index
+    );
+}
+
+// compare next token with passed token
+static bool json_token_equals(
+    json_ctx_t *ctx, const char *token, size_t length
+) {
+    for (size_t i = 0; i < length; ++i)
+        if (ctx->text[ctx->index + i] != token[i])
+            return false;
+
+    return true;
+}
+
+// error if next token does not equal passed token, otherwise skip
+static void json_expect_token(
+    json_ctx_t *ctx, const char *token, size_t length
+) {
+    if (!json_token_equals(ctx, token, length))
+        JSON_CTX_ERROR(ctx, "unknown token, expected \"%s\".\n", token);
+
+    ctx->index += length;
+}
+
+// error if a string, number or literal runs straight into another token. the
+// structural index only records tokens that follow a separator, so this is
+// what keeps it from skipping over garbage like the 'x' in "truex"
+static void json_expect_terminator(json_ctx_t *ctx) {
+    switch (ctx->text[ctx->index]) {
+    case ' ':
+    case '\n':
+    case '\r':
+    case '\t':
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',':
+    case '\0':
+        return;
+    default:
+        JSON_CTX_ERROR(ctx, "unknown token, expected separator.\n");
+    }
+}
+
+// error unless the 4 chars after the current index are hex digits, otherwise
+// return their value and leave the index on the last one
+static uint32_t json_expect_hex4(json_ctx_t *ctx) {
+    uint32_t value = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        char ch = ++ctx->index < ctx->len ? ctx->text[ctx->index] : '\0';
+        uint32_t digit = 0;
+
+        if (ch >= '0' && ch <= '9')
+            digit = (uint32_t)(ch - '0');
+        else if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')
+            digit = (uint32_t)((ch | 0x20) - 'a' + 10);
+        else if (ch == '\0')
+            JSON_CTX_ERROR(ctx, "string ended unexpectedly.\n");
+        else
+            JSON_CTX_ERROR(ctx, "expected 4 hex digits in unicode escape.\n");
+
+        value = value << 4 | digit;
+    }
+
+    return value;
+}
+
+// writes a code point as 1 to 4 bytes of utf-8, returns the number written
+static size_t json_utf8_encode(uint32_t code, char *out) {
+    if (code < 0x80) {
+        out[0] = (char)code;
+
+        return 1;
+    } else if (code < 0x800) {
+        out[0] = (char)(0xC0 | code >> 6);
+        out[1] = (char)(0x80 | (code & 0x3F));
+
+        return 2;
+    } else if (code < 0x10000) {
+        out[0] = (char)(0xE0 | code >> 12);
+        out[1] = (char)(0x80 | (code >> 6 & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+
+        return 3;
+    }
+
+    out[0] = (char)(0xF0 | code >> 18);
+    out[1] = (char)(0x80 | (code >> 12 & 0x3F));
+    out[2] = (char)(0x80 | (code >> 6 & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+
+    return 4;
+}
+
+// error if next characters are not a valid escape sequence, otherwise write
+// the escaped chars to out and skip. unicode escapes are decoded to utf-8, so
+// out needs room for 4 chars. returns the number of chars written, which is
+// never more than the escape itself took up
+static size_t json_expect_escape(json_ctx_t *ctx, char *out) {
+    switch (ctx->text[++ctx->index]) {
+#define X(a, b) case a: *out = b; break;
+    JSON_ESCAPE_CHARACTERS_X
+#undef X
+    case 'u': {
+        uint32_t code = json_expect_hex4(ctx);
+
+        // characters outside of the basic multilingual plane are written as
+        // a utf-16 surrogate pair
+        if (code >= 0xD800 && code <= 0xDBFF
+         && ctx->index + 2 < ctx->len
+         && ctx->text[ctx->index + 1] == '\\'
+         && ctx->text[ctx->index + 2] == 'u') {
+            ctx->index += 2;
+
+            uint32_t low = json_expect_hex4(ctx);
+
+            if (low < 0xDC00 || low > 0xDFFF)
+                JSON_CTX_ERROR(ctx, "unpaired surrogate in unicode escape.\n");
+
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        } else if (code >= 0xD800 && code <= 0xDFFF) {
+            JSON_CTX_ERROR(ctx, "unpaired surrogate in unicode escape.\n");
+        }
+
+        ++ctx->index;
+
+        return json_utf8_encode(code, out);
+    }
+    case '\0':
+        // not printed with %c, which would cut the message off
+        JSON_CTX_ERROR(ctx, "string ended unexpectedly.\n");
+    default:
+        JSON_CTX_ERROR(
+            ctx,
+            "unknown character escape: '%c' (%hhX)\n",
+            ctx->text[ctx->index], ctx->text[ctx->index]
+        );
+    }
+
+    ++ctx->index;
+
+    return 1;
+}
+
+// returns the length of the run of plain string characters at the start of
+// text, stopping at a double quote, backslash or control character. avail is
+// the number of bytes that may be read
+static size_t json_string_run(const char *text, size_t avail) {
+    size_t i = 0;
+
+#if defined(JSON_AVX2)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+
+    for (; i + 32 <= avail; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i stop = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, quote),
+                _mm256_cmpeq_epi8(v, backslash)
+            ),
+            // v <= 0x1F
+            _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control)
+        );
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(stop);
+
+        if (mask)
+            return i + json_ctz64(mask);
+    }
+#elif defined(JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+    for (; i + 16 <= avail; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i stop = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, quote),
+                _mm_cmpeq_epi8(v, backslash)
+            ),
+            // v <= 0x1F
+            _mm_cmpeq_epi8(_mm_max_epu8(v, control), control)
+        );
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(stop);
+
+        if (mask)
+            return i + json_ctz64(mask);
+    }
+#endif
+
+    for (; i < avail; ++i) {
+        unsigned char ch = (unsigned char)text[i];
+
+        if (ch == '"' || ch == '\\' || ch < 0x20)
+            break;
+    }
+
+    return i;
+}
+
+// returns the length of the run of chars at the start of text which aren't
+// quotes or brackets, which is all that matters when skipping over a container.
+// '[' and ']' only differ from '{' and '}' by 0x20, so both are found with one
+// compare each
+static size_t json_bracket_run(const char *text, size_t avail) {
+    size_t i = 0;
+
+#if defined(JSON_AVX2)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i fold = _mm256_set1_epi8(0x20);
+
+    for (; i + 32 <= avail; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i folded = _mm256_or_si256(v, fold);
+        __m256i stop = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(folded, open),
+                _mm256_cmpeq_epi8(folded, close)
+            ),
+            _mm256_cmpeq_epi8(v, quote)
+        );
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(stop);
+
+        if (mask)
+            return i + json_ctz64(mask);
+    }
+#elif defined(JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i fold = _mm_set1_epi8(0x20);
+
+    for (; i + 16 <= avail; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i folded = _mm_or_si128(v, fold);
+        __m128i stop = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(folded, open),
+                _mm_cmpeq_epi8(folded, close)
+            ),
+            _mm_cmpeq_epi8(v, quote)
+        );
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(stop);
+
+        if (mask)
+            return i + json_ctz64(mask);
+    }
+#endif
+
+    for (; i < avail; ++i) {
+        char folded = (char)(text[i] | 0x20);
+
+        if (folded == '{' || folded == '}' || text[i] == '"')
+            break;
+    }
+
+    return i;
+}
+
+// moves a string being read to a bigger reservation on a fresh page
+static char *json_string_grow(
+    json_t *json, char *str, size_t len, size_t size, size_t *cap
+) {
+    if (size < *cap << 1)
+        size = *cap << 1;
+
+    char *grown = json_page_reserve(json, size);
+
+    memcpy(grown, str, len);
+    *cap = json->page_size - json->used;
+
+    return grown;
+}
+
+// in situ version of json_expect_string, returns the string decoded in place
+// in the text. escapes only ever shrink a string, so it can be compacted
+// behind the read position
+static char *json_expect_string_insitu(json_ctx_t *ctx, size_t *out_len) {
+    char *text = (char *)ctx->text;
+    size_t start_index = ctx->index;
+    bool has_escapes = false;
+
+    // find the end of the string
+    while (1) {
+        ctx->index += json_string_run(text + ctx->index, ctx->len - ctx->index);
+
+        char ch = text[ctx->index];
+
+        if (ch == '\"') {
+            break;
+        } else if (ch == '\\') {
+            char escaped[4];
+
+            json_expect_escape(ctx, escaped);
+            has_escapes = true;
+        } else if (ch == '\0' || ch == '\n') {
+            JSON_CTX_ERROR(ctx, "string ended unexpectedly.\n");
+        } else {
+            JSON_CTX_ERROR(ctx, "unescaped control character in string.\n");
+        }
+    }
+
+    size_t end_index = ctx->index;
+
+    if (ctx->idx)
+        json_index_sync(ctx, end_index);
+
+    // compact escapes
+    size_t length = end_index - start_index;
+
+    if (has_escapes) {
+        size_t dst = start_index;
+
+        ctx->index = start_index;
+
+        while (ctx->index < end_index) {
+            size_t run = json_string_run(
+                text + ctx->index,
+                end_index - ctx->index
+            );
+
+            memmove(text + dst, text + ctx->index, run);
+            dst += run;
+            ctx->index += run;
+
+            if (ctx->index < end_index)
+                dst += json_expect_escape(ctx, text + dst);
+        }
+
+        length = dst - start_index;
+    }
+
+    text[start_index + length] = '\0';
+    *out_len = length;
+
+    ctx->index = end_index + 1; // skip ending double quote
+
+    json_expect_terminator(ctx);
+
+    return text + start_index;
+}
+
+// return string allocated on ctx allocator if valid string, otherwise error.
+// the string is decoded straight into the free space at the top of the page in
+// a single pass. its length is stored in out_len
+static char *json_expect_string(json_ctx_t *ctx, size_t *out_len) {
+    if (ctx->text[ctx->index++] != '\"')
+        JSON_CTX_ERROR(ctx, "unknown token, expected string.\n");
+
+    if (ctx->insitu)
+        return json_expect_string_insitu(ctx, out_len);
+
+    json_t *json = ctx->json;
+    size_t cap = json->page_size - json->used;
+    char *str = json_page_reserve(json, 1);
+    size_t length = 0;
+
+    while (1) {
+        // copy plain characters in bulk
+        size_t run = json_string_run(
+            ctx->text + ctx->index,
+            ctx->len - ctx->index
+        );
+
+        // + 4 leaves room for a decoded escape or the null terminator
+        if (length + run + 4 > cap)
+            str = json_string_grow(json, str, length, length + run + 4, &cap);
+
+        memcpy(str + length, ctx->text + ctx->index, run);
+        length += run;
+        ctx->index += run;
+
+        // handle whatever stopped the run
+        char ch = ctx->text[ctx->index];
+
+        if (ch == '\"')
+            break;
+        else if (ch == '\\')
+            length += json_expect_escape(ctx, str + length);
+        else if (ch == '\0' || ch == '\n' || ctx->index >= ctx->len)
+            JSON_CTX_ERROR(ctx, "string ended unexpectedly.\n");
+        else
+            JSON_CTX_ERROR(ctx, "unescaped control character in string.\n");
+    }
+
+    str[length] = '\0';
+    json_page_commit(json, length + 1);
+    *out_len = length;
+
+    ++ctx->index; // skip ending double quote
+
+    json_expect_terminator(ctx);
+
+    return str;
+}
+
+// powers of ten which are exactly representable as doubles
+static const double json_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// largest mantissa a double stores exactly
+#define JSON_MAX_EXACT_MANTISSA ((uint64_t)1 << 53)
+// mantissa digits that always fit in a uint64_t
+#define JSON_MAX_MANTISSA_DIGITS 19
+#define JSON_MAX_EXACT_POW10 22
+
+// correctly rounded fallback for numbers the fast path can't convert. the
+// decimal point is swapped for the locale's so that the result doesn't depend
+// on setlocale(). long numbers are copied to the top of the json_t's page
+// without claiming it, so they don't allocate once the pages are warm
+static double json_strtod(json_ctx_t *ctx, const char *text, size_t length) {
+    const json_allocator_t *a = ctx->allocator;
+    char buf[64];
+    char *str = buf;
+
+    if (length >= sizeof(buf)) {
+        str = ctx->json
+            ? json_page_reserve(ctx->json, length + 1)
+            : (char *)a->alloc(a->user, length + 1);
+    }
+
+    char point = *localeconv()->decimal_point;
+
+    memcpy(str, text, length);
+    str[length] = '\0';
+
+    for (size_t i = 0; i < length; ++i)
+        if (str[i] == '.')
+            str[i] = point;
+
+    double number = strtod(str, NULL);
+
+    if (str != buf && !ctx->json)
+        a->free(a->user, str);
+
+    return number;
+}
+
+// converts a validated number without a fraction or exponent. returns false
+// if it doesn't fit in an int64_t
+static inline bool json_make_integer(
+    json_object_t *object, uint64_t magnitude, bool negative
+) {
+    if (negative) {
+        // -0 stays a double so that its sign isn't lost
+        if (!magnitude || magnitude > (uint64_t)INT64_MAX + 1)
+            return false;
+
+        object->data.integer = -(int64_t)(magnitude - 1) - 1;
+    } else {
+        if (magnitude > (uint64_t)INT64_MAX)
+            return false;
+
+        object->data.integer = (int64_t)magnitude;
+    }
+
+    object->type = JSON_INTEGER;
+
+    return true;
+}
+
+// validates a number while accumulating its decimal mantissa and exponent,
+// and fills object in with it. integers are stored exactly. otherwise when
+// mantissa and exponent are small enough the double is computed exactly with a
+// single multiplication or division (clinger's fast path), which covers almost
+// all numbers found in real documents
+static void json_expect_number(json_ctx_t *ctx, json_object_t *object) {
+    const char *text = ctx->text;
+    size_t start_index = ctx->index;
+    bool negative = false, truncated = false, integral = true;
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+
+    // minus symbol
+    if (text[ctx->index] == '-') {
+        negative = true;
+        ++ctx->index;
+    }
+
+    // integral component
+    if (!json_is_digit(text[ctx->index]))
+        JSON_CTX_ERROR(ctx, "expected digit.\n");
+
+    if (text[ctx->index] == '0') {
+        if (json_is_digit(text[++ctx->index]))
+            JSON_CTX_ERROR(ctx, "leading zeros are not allowed.\n");
+    }
+
+    while (json_is_digit(text[ctx->index])) {
+        int digit = text[ctx->index++] - '0';
+
+        if (digits < JSON_MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + digit;
+            ++digits;
+        } else {
+            truncated |= digit != 0;
+            ++exponent;
+        }
+    }
+
+    // fractional component
+    if (text[ctx->index] == '.') {
+        integral = false;
+        ++ctx->index;
+
+        if (!json_is_digit(text[ctx->index]))
+            JSON_CTX_ERROR(ctx, "expected digit.\n");
+
+        while (json_is_digit(text[ctx->index])) {
+            int digit = text[ctx->index++] - '0';
+
+            if (digits < JSON_MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + digit;
+                --exponent;
+
+                // leading zeros aren't significant
+                if (mantissa)
+                    ++digits;
+            } else {
+                truncated |= digit != 0;
+            }
+        }
+    }
+
+    // exponential component
+    if (text[ctx->index] == 'e' || text[ctx->index] == 'E') {
+        bool exp_negative = false;
+        int exp_value = 0;
+
+        integral = false;
+        ++ctx->index;
+
+        // read exponent
+        if (text[ctx->index] == '+' || text[ctx->index] == '-')
+            exp_negative = text[ctx->index++] == '-';
+
+        if (!json_is_digit(text[ctx->index]))
+            JSON_CTX_ERROR(ctx, "expected digit.\n");
+
+        while (json_is_digit(text[ctx->index])) {
+            // saturate, anything this big is already zero or infinity
+            if (exp_value < 100000)
+                exp_value = exp_value * 10 + (text[ctx->index] - '0');
+
+            ++ctx->index;
+        }
+
+        exponent += exp_negative ? -exp_value : exp_value;
+    }
+
+    json_expect_terminator(ctx);
+
+    // only validating
+    if (!object)
+        return;
+
+    // number is valid json and accepted, can convert
+    if (integral && !exponent && json_make_integer(object, mantissa, negative))
+        return;
+
+    object->type = JSON_NUMBER;
+
+    if (!mantissa) {
+        object->data.number = negative ? -0.0 : 0.0;
+        return;
+    }
+
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+    // move excess exponent into the mantissa when that keeps it exact, so
+    // things like 12e30 still take the fast path
+    if (!truncated
+     && exponent > JSON_MAX_EXACT_POW10
+     && exponent <= JSON_MAX_EXACT_POW10 + 15
+     && mantissa <= JSON_MAX_EXACT_MANTISSA
+        / (uint64_t)json_pow10[exponent - JSON_MAX_EXACT_POW10]) {
+        mantissa *= (uint64_t)json_pow10[exponent - JSON_MAX_EXACT_POW10];
+        exponent = JSON_MAX_EXACT_POW10;
+    }
+
+    if (!truncated
+     && mantissa <= JSON_MAX_EXACT_MANTISSA
+     && exponent >= -JSON_MAX_EXACT_POW10
+     && exponent <= JSON_MAX_EXACT_POW10) {
+        double number = (double)mantissa;
+
+        if (exponent < 0)
+            number /= json_pow10[-exponent];
+        else
+            number *= json_pow10[exponent];
+
+        object->data.number = negative ? -number : number;
+        return;
+    }
+#endif
+
+    object->data.number = json_strtod(
+        ctx,
+        text + start_index,
+        ctx->index - start_index
+    );
+}
+
+// maximum nesting of objects and arrays, deeper input is an error
+#ifndef JSON_MAX_DEPTH
+#define JSON_MAX_DEPTH 1024
+#endif
+
+#define JSON_INIT_STACK_CAP 32
+#define JSON_INIT_ITEM_CAP 256
+
+// an open object or array on the parser's container stack
+typedef struct json_frame {
+    json_object_t *container;
+    char *key; // key of the value being parsed, if container is an object
+    size_t key_len;
+    size_t first; // index of the container's first item
+} json_frame_t;
+
+// a finished value of an open container. items are collected on one stack
+// shared by all open containers, and a container's hmap or vec is only made
+// once it closes, at its final size
+typedef struct json_item {
+    json_object_t *object;
+    char *key;
+    size_t key_len;
+} json_item_t;
+
+static void json_stack_push(json_ctx_t *ctx, json_object_t *container) {
+    if (ctx->depth == ctx->stack_cap) {
+        ctx->stack_cap = ctx->stack_cap ? ctx->stack_cap << 1
+                                        : JSON_INIT_STACK_CAP;
+        ctx->stack = (json_frame_t *)json_fat_realloc(
+            ctx->allocator,
+            ctx->stack,
+            ctx->stack_cap * sizeof(*ctx->stack)
+        );
+    }
+
+    ctx->stack[ctx->depth].container = container;
+    ctx->stack[ctx->depth++].first = ctx->item_count;
+}
+
+static json_item_t *json_item_push(json_ctx_t *ctx) {
+    if (ctx->item_count == ctx->item_cap) {
+        ctx->item_cap = ctx->item_cap ? ctx->item_cap << 1
+                                      : JSON_INIT_ITEM_CAP;
+        ctx->items = (json_item_t *)json_fat_realloc(
+            ctx->allocator,
+            ctx->items,
+            ctx->item_cap * sizeof(*ctx->items)
+        );
+    }
+
+    return &ctx->items[ctx->item_count++];
+}
+
+// fills in a scalar value
+static void json_expect_scalar(json_ctx_t *ctx, json_object_t *object) {
+    switch (ctx->text[ctx->index]) {
+    case '"':
+        object->data.string = json_expect_string(ctx, &object->length);
+        object->type = JSON_STRING;
+
+        break;
+    case 't':
+        json_expect_token(ctx, "true", 4);
+        json_expect_terminator(ctx);
+        object->type = JSON_TRUE;
+
+        break;
+    case 'f':
+        json_expect_token(ctx, "false", 5);
+        json_expect_terminator(ctx);
+        object->type = JSON_FALSE;
+
+        break;
+    case 'n':
+        json_expect_token(ctx, "null", 4);
+        json_expect_terminator(ctx);
+        object->type = JSON_NULL;
+
+        break;
+    default:;
+        // could be number
+        if (json_is_digit(ctx->text[ctx->index])
+         || ctx->text[ctx->index] == '-') {
+            json_expect_number(ctx, object);
+
+            break;
+        }
+
+        JSON_CTX_ERROR(ctx, "unknown token, expected value.\n");
+    }
+}
+
+static json_object_t *json_new_slot(json_ctx_t *ctx) {
+    json_object_t *object = (json_object_t *)json_page_alloc(
+        ctx->json,
+        sizeof(json_object_t)
+    );
+
+    object->lazy = false;
+
+    return object;
+}
+
+// makes ctx->object an object or array and opens it. its data is made when it
+// closes, see json_close_container()
+static void json_open_container(json_ctx_t *ctx, char ch) {
+    if (ctx->base_depth + ctx->depth == JSON_MAX_DEPTH)
+        JSON_CTX_ERROR(ctx, "exceeded maximum depth of %d.\n", JSON_MAX_DEPTH);
+
+    ctx->object->type = ch == '{' ? JSON_OBJECT : JSON_ARRAY;
+
+    ++ctx->index; // skip '{' or '['
+
+    json_stack_push(ctx, ctx->object);
+    ctx->state = JSON_STATE_OPENED;
+}
+
+// makes the hmap or vec of the container which just closed from its items on
+// top of the item stack, then pops them
+static void json_close_container(
+    json_ctx_t *ctx, json_object_t *container, size_t first
+) {
+    json_t *json = ctx->json;
+    json_item_t *items = ctx->items + first;
+    size_t count = ctx->item_count - first;
+
+    if (container->type == JSON_OBJECT) {
+        json_hmap_t *hmap = (json_hmap_t *)json_page_alloc(
+            json,
+            sizeof(*hmap)
+        );
+
+        json_hmap_make(json, hmap, count);
+
+        // put rather than fill in directly, a repeated key keeps its first
+        // position and its last value
+        for (size_t i = 0; i < count; ++i)
+            json_hmap_put(
+                json, hmap, items[i].key, items[i].key_len, items[i].object
+            );
+
+        container->data.hmap = hmap;
+    } else {
+        json_vec_t *vec = (json_vec_t *)json_page_alloc(json, sizeof(*vec));
+
+        json_vec_make(json, vec, count);
+
+        for (size_t i = 0; i < count; ++i)
+            vec->data[i] = items[i].object;
+
+        vec->size = count;
+        container->data.vec = vec;
+    }
+
+    ctx->item_count = first;
+}
+
+// the length of a container nested in a lazy one, which is measured while the
+// outermost one around it is skipped so that no text is scanned twice
+typedef struct json_lazy_span {
+    size_t len; // from the opening bracket up to and including the closing one
+    size_t count; // containers nested in this one, which come right after it
+} json_lazy_span_t;
+
+// an unparsed object or array
+typedef struct json_lazy {
+    json_t *json;
+    const char *text; // starting at the opening bracket
+    size_t len; // up to and including the closing bracket
+    size_t depth; // containers around this one
+    // the containers nested in this one, in the order they open
+    const json_lazy_span_t *spans;
+    size_t span_count;
+} json_lazy_t;
+
+// finds the length of the container at ctx->index, and of every container
+// nested in it, which are stored in order on top of the current page. nothing
+// inside is checked other than brackets, strings and depth
+static size_t json_lazy_skip(
+    json_ctx_t *ctx, const json_lazy_span_t **out_spans, size_t *out_count
+) {
+    json_t *json = ctx->json;
+    const char *text = ctx->text;
+    size_t start = ctx->index, i = start + 1, depth = 1;
+    size_t outer = ctx->base_depth + ctx->depth;
+    json_lazy_span_t *spans = NULL;
+    // while a span is open its len holds its start and its count the span
+    // around it, which are filled in when it closes
+    size_t count = 0, cap = 0, open = 0;
+
+    while (depth) {
+        // strings which aren't closed, and escapes at their ends, can go past
+        if (i < ctx->len)
+            i += json_bracket_run(text + i, ctx->len - i);
+
+        if (i >= ctx->len) {
+            ctx->index = i;
+            JSON_CTX_ERROR(ctx, "unexpected end of text.\n");
+        }
+
+        switch (text[i]) {
+        case '"':
+            for (++i; i < ctx->len && text[i] != '"';) {
+                i += json_string_run(text + i, ctx->len - i);
+
+                if (i < ctx->len && text[i] != '"')
+                    i += text[i] == '\\' ? 2 : 1;
+            }
+
+            break;
+        case '{':
+        case '[':
+            if (outer + depth == JSON_MAX_DEPTH) {
+                ctx->index = i;
+                JSON_CTX_ERROR(
+                    ctx, "exceeded maximum depth of %d.\n", JSON_MAX_DEPTH
+                );
+            }
+
+            // spans are built like a string, in the free space at the top of
+            // the page
+            if (!cap) {
+                json->used = (json->used + JSON_PAGE_ALIGN - 1)
+                           & ~(JSON_PAGE_ALIGN - 1);
+                spans = (json_lazy_span_t *)json_page_reserve(
+                    json, sizeof(*spans)
+                );
+                cap = json->page_size - json->used;
+            } else if ((count + 1) * sizeof(*spans) > cap) {
+                spans = (json_lazy_span_t *)json_string_grow(
+                    json, (char *)spans, count * sizeof(*spans),
+                    (count + 1) * sizeof(*spans), &cap
+                );
+            }
+
+            spans[count].len = i;
+            spans[count].count = open;
+            open = count++;
+            ++depth;
+
+            break;
+        case '}':
+        case ']':
+            if (--depth) {
+                json_lazy_span_t *span = &spans[open];
+
+                open = span->count;
+                span->len = i + 1 - span->len;
+                span->count = count - (size_t)(span - spans) - 1;
+            }
+
+            break;
+        }
+
+        ++i;
+    }
+
+    if (count)
+        json_page_commit(json, count * sizeof(*spans));
+
+    *out_spans = spans;
+    *out_count = count;
+
+    return i - start;
+}
+
+// makes ctx->object a lazy object or array for the text from the bracket at
+// ctx->index to its matching bracket, and skips to after it. its length comes
+// from ctx->spans if the text around it was skipped before
+static void json_lazy_container(json_ctx_t *ctx, char ch) {
+    const json_lazy_span_t *spans;
+    size_t len, span_count;
+
+    if (ctx->base_depth + ctx->depth == JSON_MAX_DEPTH)
+        JSON_CTX_ERROR(ctx, "exceeded maximum depth of %d.\n", JSON_MAX_DEPTH);
+
+    if (ctx->span_count) {
+        const json_lazy_span_t *span = ctx->spans;
+
+        len = span->len;
+        spans = span + 1;
+        span_count = span->count;
+
+        ctx->spans += 1 + span_count;
+        ctx->span_count -= 1 + span_count;
+    } else {
+        len = json_lazy_skip(ctx, &spans, &span_count);
+    }
+
+    json_lazy_t *lazy = (json_lazy_t *)json_page_alloc(
+        ctx->json,
+        sizeof(*lazy)
+    );
+
+    lazy->json = ctx->json;
+    lazy->text = ctx->text + ctx->index;
+    lazy->len = len;
+    lazy->depth = ctx->base_depth + ctx->depth;
+    lazy->spans = spans;
+    lazy->span_count = span_count;
+
+    ctx->object->type = ch == '{' ? JSON_OBJECT : JSON_ARRAY;
+    ctx->object->data.lazy = lazy;
+    ctx->object->lazy = true;
+    ctx->index += len;
+}
+
+// stores the finished value in ctx->object in the open container
+static void json_close_value(json_ctx_t *ctx) {
+    if (!ctx->depth) {
+        ctx->state = ctx->embedded ? JSON_STATE_DONE : JSON_STATE_END;
+        return;
+    }
+
+    json_frame_t *frame = &ctx->stack[ctx->depth - 1];
+    json_item_t *item = json_item_push(ctx);
+
+    item->object = ctx->object;
+
+    if (frame->container->type == JSON_OBJECT) {
+        item->key = frame->key;
+        item->key_len = frame->key_len;
+    }
+
+    ctx->state = JSON_STATE_NEXT;
+}
+
+// steps the parser one token at a time until it is done, or the next token
+// starts at or after limit. rather than recursing, open objects and arrays are
+// kept on ctx's container stack, so nesting costs a push instead of a call and
+// parsing can be resumed where it stopped
+static void json_run(json_ctx_t *ctx, size_t limit) {
+    while (ctx->state != JSON_STATE_DONE) {
+        json_next_token(ctx);
+
+        if (ctx->index >= limit)
+            return;
+
+        char ch = ctx->text[ctx->index];
+
+        switch (ctx->state) {
+        case JSON_STATE_ROOT:
+            if (ch == '{' || ch == '[') {
+                ctx->json->root = ctx->object = json_new_slot(ctx);
+                json_open_container(ctx, ch);
+            } else if (ch == '\0' && ctx->index == ctx->len) {
+                // empty json is still valid json
+                ctx->json->root = NULL;
+                ctx->state = JSON_STATE_DONE;
+            } else {
+                JSON_CTX_ERROR(ctx, "invalid json root.\n");
+            }
+
+            break;
+        case JSON_STATE_VALUE:
+            if (ch != '{' && ch != '[') {
+                json_expect_scalar(ctx, ctx->object);
+                json_close_value(ctx);
+            } else if (ctx->lazy && ctx->depth) {
+                json_lazy_container(ctx, ch);
+                json_close_value(ctx);
+            } else {
+                json_open_container(ctx, ch);
+            }
+
+            break;
+        case JSON_STATE_OPENED:
+        case JSON_STATE_NEXT: {
+            json_object_t *container = ctx->stack[ctx->depth - 1].container;
+            bool is_obj = container->type == JSON_OBJECT;
+
+            if (ch == (is_obj ? '}' : ']')) {
+                ++ctx->index;
+                --ctx->depth;
+
+                json_close_container(
+                    ctx,
+                    container,
+                    ctx->stack[ctx->depth].first
+                );
+
+                ctx->object = container;
+                json_close_value(ctx);
+
+                break;
+            }
+
+            if (ctx->state == JSON_STATE_NEXT)
+                json_expect_token(ctx, ",", 1);
+
+            if (is_obj) {
+                ctx->state = JSON_STATE_KEY;
+            } else {
+                ctx->object = json_new_slot(ctx);
+                ctx->state = JSON_STATE_VALUE;
+            }
+
+            break;
+        }
+        case JSON_STATE_KEY: {
+            json_frame_t *frame = &ctx->stack[ctx->depth - 1];
+
+            frame->key = json_expect_string(ctx, &frame->key_len);
+            ctx->state = JSON_STATE_COLON;
+
+            break;
+        }
+        case JSON_STATE_COLON:
+            json_expect_token(ctx, ":", 1);
+
+            ctx->object = json_new_slot(ctx);
+            ctx->state = JSON_STATE_VALUE;
+
+            break;
+        case JSON_STATE_END:
+            if (ch == '\0' && ctx->index < ctx->len)
+                JSON_CTX_ERROR(ctx, "unexpected null character.\n");
+
+            json_expect_token(ctx, "", 1);
+            ctx->state = JSON_STATE_DONE;
+
+            break;
+        case JSON_STATE_DONE:
+            break;
+        }
+    }
+}
+
+// sets ctx up to parse text from the root. texts of at least JSON_INDEX_MIN
+// bytes are indexed with idx if it isn't NULL
+static void json_ctx_make(
+    json_ctx_t *ctx, json_t *json, const char *text, size_t len,
+    json_index_t *idx
+) {
+    ctx->json = json;
+    ctx->allocator = json ? &json->allocator : &json_default_allocator;
+    ctx->text = text;
+    ctx->index = 0;
+    ctx->len = len;
+    ctx->idx = idx && len >= JSON_INDEX_MIN ? idx : NULL;
+    ctx->insitu = false;
+    ctx->error = NULL;
+    ctx->embedded = ctx->lazy = false;
+    ctx->base_depth = ctx->span_count = 0;
+    ctx->spans = NULL;
+    ctx->state = JSON_STATE_ROOT;
+    ctx->object = NULL;
+    ctx->stack = NULL;
+    ctx->items = NULL;
+    ctx->depth = ctx->item_count = 0;
+
+    // json's scratch is taken while ctx uses it, and given back by
+    // json_ctx_kill()
+    if (json) {
+        ctx->stack = json->stack;
+        ctx->items = json->items;
+        json->stack = NULL;
+        json->items = NULL;
+    }
+
+    ctx->stack_cap = ctx->stack
+        ? json_fat_size(ctx->stack) / sizeof(*ctx->stack) : 0;
+    ctx->item_cap = ctx->items
+        ? json_fat_size(ctx->items) / sizeof(*ctx->items) : 0;
+
+    if (ctx->idx)
+        json_index_make(ctx);
+}
+
+static void json_ctx_kill(json_ctx_t *ctx) {
+    json_t *json = ctx->json;
+
+    if (ctx->stack) {
+        if (json && !json->stack)
+            json->stack = ctx->stack;
+        else
+            json_fat_free(ctx->allocator, ctx->stack);
+    }
+
+    if (ctx->items) {
+        if (json && !json->items)
+            json->items = ctx->items;
+        else
+            json_fat_free(ctx->allocator, ctx->items);
+    }
+
+    if (ctx->idx)
+        json_index_kill(ctx);
+}
+
+// json_run, but if ctx->error is set errors are caught, returning false
+static bool json_run_catch(json_ctx_t *ctx, size_t limit) {
+    jmp_buf jmp;
+
+    if (ctx->error) {
+        ctx->jmp = &jmp;
+
+        if (setjmp(jmp))
+            return false;
+    }
+
+    json_run(ctx, limit);
+
+    return true;
+}
+
+// text[len] must be a null terminator. if error is set, errors are stored
+// there and false is returned, otherwise they exit
+static bool json_parse(
+    json_t *json, const char *text, size_t len, bool insitu,
+    json_error_t *error
+) {
+    json_ctx_t ctx;
+    json_index_t idx;
+
+    json_ctx_make(&ctx, json, text, len, &idx);
+    ctx.insitu = insitu;
+    ctx.error = error;
+
+    // the null terminator is parsed as the final token
+    bool parsed = json_run_catch(&ctx, len + 1);
+
+    json_ctx_kill(&ctx);
+
+    if (!parsed)
+        json->root = NULL;
+
+    return parsed;
+}
+
+// same as json_parse, but text doesn't need to be null terminated.
+//
+// everything up to the root's closing bracket is parsed in place, stopping
+// before the bracket so that nothing past it is read. the bracket itself is
+// then parsed from a null terminated copy
+static bool json_parse_n(
+    json_t *json, const char *text, size_t len, json_error_t *error
+) {
+    size_t end = len;
+
+    while (end && json_is_whitespace(text[end - 1]))
+        --end;
+
+    if (!end || (text[end - 1] != '}' && text[end - 1] != ']')) {
+        // empty or invalid json, parse a terminated copy to find out which
+        const json_allocator_t *a = &json->allocator;
+        char *copy = (char *)a->alloc(a->user, end + 1);
+
+        memcpy(copy, text, end);
+        copy[end] = '\0';
+
+        bool parsed = json_parse(json, copy, end, false, error);
+
+        a->free(a->user, copy);
+
+        return parsed;
+    }
+
+    json_ctx_t ctx;
+    json_index_t idx;
+
+    json_ctx_make(&ctx, json, text, end - 1, &idx);
+    ctx.error = error;
+
+    bool parsed = json_run_catch(&ctx, end - 1);
+
+    if (parsed) {
+        char tail[2] = {text[end - 1], '\0'};
+
+        if (ctx.idx)
+            json_index_kill(&ctx);
+
+        ctx.text = tail;
+        ctx.index = 0;
+        ctx.len = 1;
+
+        parsed = json_run_catch(&ctx, 2);
+
+        // locate the error in text rather than tail
+        if (!parsed)
+            json_error_locate(error, text, end - 1);
+    }
+
+    json_ctx_kill(&ctx);
+
+    if (!parsed)
+        json->root = NULL;
+
+    return parsed;
+}
+
+// parses a lazy object or array's members in place, leaving the objects and
+// arrays among them lazy
+static void json_lazy_expand(json_object_t *object) {
+    json_lazy_t *lazy = object->data.lazy;
+    json_ctx_t ctx;
+
+    json_ctx_make(&ctx, lazy->json, lazy->text, lazy->len, NULL);
+    ctx.embedded = ctx.lazy = true;
+    ctx.base_depth = lazy->depth;
+    ctx.spans = lazy->spans;
+    ctx.span_count = lazy->span_count;
+    ctx.state = JSON_STATE_VALUE;
+    ctx.object = object;
+
+    object->lazy = false;
+
+    json_run(&ctx, lazy->len);
+
+    if (ctx.state != JSON_STATE_DONE)
+        JSON_CTX_ERROR(&ctx, "unexpected end of text.\n");
+
+    // only the root has text after it, which is checked like any other text's
+    // end
+    if (ctx.index < lazy->len) {
+        ctx.state = JSON_STATE_END;
+        json_run(&ctx, lazy->len + 1);
+    }
+
+    json_ctx_kill(&ctx);
+}
+
+static inline void json_expand(json_object_t *object) {
+    if (object->lazy)
+        json_lazy_expand(object);
+}
+
+// lifetime api ================================================================
+
+void json_load_empty_ex(json_t *json, const json_arena_opts_t *opts) {
+    size_t hint = opts ? opts->size_hint : 0;
+    size_t first = JSON_PAGE_SIZE;
+
+    json->root = NULL;
+    json->allocator = opts && opts->allocator
+        ? *opts->allocator
+        : json_default_allocator;
+    json->page_max = opts && opts->max_page_size
+        ? opts->max_page_size
+        : JSON_MAX_PAGE_SIZE;
+
+    if (hint) {
+        first = hint < json->page_max / JSON_HINT_RATIO
+            ? hint * JSON_HINT_RATIO
+            : json->page_max;
+
+        if (first < JSON_MIN_PAGE_SIZE)
+            first = JSON_MIN_PAGE_SIZE;
+    }
+
+    if (first > json->page_max)
+        first = json->page_max;
+
+    // page allocator
+    json->cur_page = json->used = 0;
+    json->page_size = first;
+    json->page_grow = json_page_next_size(json, first);
+    json->page_cap = JSON_INIT_PAGE_CAP;
+    json->page_count = 1;
+    json->pages = (char **)json_fat_alloc(
+        &json->allocator,
+        json->page_cap * sizeof(*json->pages)
+    );
+
+    json->pages[0] = (char *)json_fat_alloc(&json->allocator, first);
+
+    memset(json->free_blocks, 0, sizeof(json->free_blocks));
+
+    json->stack = NULL;
+    json->items = NULL;
+    json->positions = NULL;
+}
+
+void json_load_empty(json_t *json) {
+    json_load_empty_ex(json, NULL);
+}
+
+// sets json up for parsing a text of len bytes, with opts' allocator and page
+// limit when given
+static void json_load_sized(
+    json_t *json, size_t len, const json_arena_opts_t *opts
+) {
+    json_arena_opts_t sized = {len, 0, NULL};
+
+    if (opts) {
+        sized = *opts;
+
+        if (!sized.size_hint)
+            sized.size_hint = len;
+    }
+
+    json_load_empty_ex(json, &sized);
+}
+
+static bool json_parse(
+    json_t *json, const char *text, size_t len, bool insitu,
+    json_error_t *error
+);
+
+void json_load_ex(json_t *json, char *text, const json_arena_opts_t *opts) {
+    size_t len = strlen(text);
+
+    json_load_sized(json, len, opts);
+    json_parse(json, text, len, false, NULL);
+}
+
+void json_load(json_t *json, char *text) {
+    json_load_ex(json, text, NULL);
+}
+
+void json_load_insitu_ex(
+    json_t *json, char *text, const json_arena_opts_t *opts
+) {
+    size_t len = strlen(text);
+
+    json_load_sized(json, len, opts);
+    json_parse(json, text, len, true, NULL);
+}
+
+void json_load_insitu(json_t *json, char *text) {
+    json_load_insitu_ex(json, text, NULL);
+}
+
+void json_load_n_ex(
+    json_t *json, const char *text, size_t len, const json_arena_opts_t *opts
+) {
+    json_load_sized(json, len, opts);
+    json_parse_n(json, text, len, NULL);
+}
+
+void json_load_n(json_t *json, const char *text, size_t len) {
+    json_load_n_ex(json, text, len, NULL);
+}
+
+void json_reload_n(json_t *json, const char *text, size_t len) {
+    json_reset(json);
+    json_parse_n(json, text, len, NULL);
+}
+
+void json_load_lazy_ex(
+    json_t *json, const char *text, size_t len, const json_arena_opts_t *opts
+) {
+    json_ctx_t ctx;
+
+    json_load_sized(json, len, opts);
+    json_ctx_make(&ctx, json, text, len, NULL);
+
+    ctx.index = json_whitespace_run(text, len);
+
+    // empty json is still valid json
+    if (ctx.index == len) {
+        json_ctx_kill(&ctx);
+        return;
+    }
+
+    char ch = text[ctx.index];
+
+    if (ch != '{' && ch != '[')
+        JSON_CTX_ERROR(&ctx, "invalid json root.\n");
+
+    // the root is found lazily too, its end is found when it's parsed
+    json_lazy_t *lazy = (json_lazy_t *)json_page_alloc(json, sizeof(*lazy));
+
+    lazy->json = json;
+    lazy->text = text + ctx.index;
+    lazy->len = len - ctx.index;
+    lazy->depth = 0;
+    lazy->spans = NULL;
+    lazy->span_count = 0;
+
+    json->root = json_new_slot(&ctx);
+    json->root->type = ch == '{' ? JSON_OBJECT : JSON_ARRAY;
+    json->root->data.lazy = lazy;
+    json->root->lazy = true;
+
+    json_ctx_kill(&ctx);
+}
+
+void json_load_lazy(json_t *json, const char *text, size_t len) {
+    json_load_lazy_ex(json, text, len, NULL);
+}
+
+// reads the rest of file into a null terminated JSON_MALLOC'd buffer. files
+// which report their size are read in a single fread, others (pipes, special
+// files) grow the buffer geometrically
+static char *json_read_file(FILE *file, size_t *out_len) {
+    size_t cap = JSON_FREAD_BUF_SIZE, len = 0;
+
+    if (!fseek(file, 0, SEEK_END)) {
+        long size = ftell(file);
+
+        // + 2 for the null terminator and to see the end of file
+        if (size > 0)
+            cap = (size_t)size + 2;
+
+        fseek(file, 0, SEEK_SET);
+    }
+
+    char *text = (char *)JSON_MALLOC(cap);
+
+    while (1) {
+        size_t num_read = fread(text + len, 1, cap - len - 1, file);
+
+        len += num_read;
+
+        if (len + 1 < cap)
+            break;
+
+        // buffer filled, there may be more
+        char *grown = (char *)JSON_MALLOC(cap << 1);
+
+        memcpy(grown, text, len);
+        JSON_FREE(text);
+
+        text = grown;
+        cap <<= 1;
+    }
+
+    text[len] = '\0';
+    *out_len = len;
+
+    return text;
+}
+
+#ifdef JSON_MMAP
+// maps a regular file followed by a null terminator, storing the file's length
+// in out_len and the mapping's in out_map_len. returns NULL if the file can't
+// be mapped, e.g. it is a pipe, so it can be read instead
+static char *json_map_file(
+    const char *filepath, size_t *out_len, size_t *out_map_len
+) {
+    int fd = open(filepath, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // the rest of the last page past the end of the file reads as zeroes, but
+    // if the file ends on a page boundary a zeroed page has to be mapped after
+    // it
+    size_t len = (size_t)st.st_size;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_len = (len / page_size + 1) * page_size;
+    char *text = (char *)MAP_FAILED;
+
+    if (len % page_size) {
+        text = (char *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    } else {
+#ifdef MAP_ANONYMOUS
+        text = (char *)mmap(
+            NULL, map_len, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+
+        if (text != MAP_FAILED) {
+            void *file_map = mmap(
+                text, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0
+            );
+
+            if (file_map == MAP_FAILED) {
+                munmap(text, map_len);
+                text = (char *)MAP_FAILED;
+            }
+        }
+#endif
+    }
+
+    // the mapping holds its own reference to the file
+    close(fd);
+
+    if (text == MAP_FAILED)
+        return NULL;
+
+#ifdef MADV_SEQUENTIAL
+    madvise(text, len, MADV_SEQUENTIAL);
+#endif
+
+    *out_len = len;
+    *out_map_len = map_len;
+
+    return text;
+}
+#endif
+
+// leaves json empty and stores an error for a file which couldn't be opened or
+// read, or exits if error is NULL. returns false
+static bool json_open_failed(
+    json_t *json, const char *filepath, const json_arena_opts_t *opts,
+    json_error_t *error
+) {
+    if (!error)
+        JSON_ERROR("could not open file: \"%s\"\n", filepath);
+
+    json_load_empty_ex(json, opts);
+
+    error->line = error->column = error->offset = 0;
+    snprintf(
+        error->message, sizeof(error->message),
+        "could not open file: \"%s\"", filepath
+    );
+
+    return false;
+}
+
+// json_load_file, but if error is set failures are stored there and false is
+// returned, otherwise they exit
+static bool json_load_file_catch(
+    json_t *json, const char *filepath, const json_arena_opts_t *opts,
+    json_error_t *error
+) {
+#ifdef JSON_MMAP
+    // parse straight from the mapping
+    size_t len, map_len;
+    char *mapped = json_map_file(filepath, &len, &map_len);
+
+    if (mapped) {
+        json_load_sized(json, len, opts);
+
+        bool parsed = json_parse(json, mapped, len, false, error);
+
+        munmap(mapped, map_len);
+
+        return parsed;
+    }
+#endif
+
+    JSON_DEBUG("reading\n");
+
+    // open and check for existance
+    FILE *file = fopen(filepath, "rb");
+
+    if (!file)
+        return json_open_failed(json, filepath, opts, error);
+
+#ifndef JSON_MMAP
+    size_t len;
+#endif
+    char *text = json_read_file(file, &len);
+
+    fclose(file);
+
+    // load and cleanup
+    JSON_DEBUG("loading\n");
+
+    json_load_sized(json, len, opts);
+
+    bool parsed = json_parse(json, text, len, false, error);
+
+    JSON_FREE(text);
+
+    return parsed;
+}
+
+void json_load_file_ex(
+    json_t *json, const char *filepath, const json_arena_opts_t *opts
+) {
+    json_load_file_catch(json, filepath, opts, NULL);
+}
+
+void json_load_file(json_t *json, const char *filepath) {
+    json_load_file_ex(json, filepath, NULL);
+}
+
+// everything, containers included, lives on the pages. the only other memory
+// is the parser scratch
+void json_unload(json_t *json) {
+    for (size_t i = 0; i < json->page_count; ++i)
+        json_fat_free(&json->allocator, json->pages[i]);
+
+    json_fat_free(&json->allocator, json->pages);
+
+    if (json->stack)
+        json_fat_free(&json->allocator, json->stack);
+
+    if (json->items)
+        json_fat_free(&json->allocator, json->items);
+
+    if (json->positions)
+        json->allocator.free(json->allocator.user, json->positions);
+}
+
+// the page array and parser scratch are kept at their current capacity, so a
+// loop which resets between parses of similar size doesn't allocate
+void json_reset(json_t *json) {
+    size_t warm = JSON_WARM_PAGES > 1 ? JSON_WARM_PAGES : 1;
+
+    for (size_t i = warm; i < json->page_count; ++i)
+        json_fat_free(&json->allocator, json->pages[i]);
+
+    if (json->page_count > warm)
+        json->page_count = warm;
+
+    memset(json->free_blocks, 0, sizeof(json->free_blocks));
+
+    json->root = NULL;
+    json->cur_page = json->used = 0;
+    json->page_size = json_fat_size(json->pages[0]);
+    json->page_grow = json_page_next_size(json, json->page_size);
+}
+
+// parallel loading ============================================================
+// files are handed out one at a time from a shared counter, so a few large
+// files don't hold up the rest. each file only ever touches its own json_t
+
+typedef struct json_load_pool {
+    const char **paths;
+    json_t *out;
+    json_error_t *errors;
+    const json_arena_opts_t *arena;
+    size_t n, next, failed;
+#ifdef JSON_PTHREADS
+    pthread_mutex_t lock;
+#endif
+} json_load_pool_t;
+
+#ifdef JSON_PTHREADS
+#define JSON_POOL_LOCK(pool) pthread_mutex_lock(&(pool)->lock)
+#define JSON_POOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->lock)
+#else
+#define JSON_POOL_LOCK(pool)
+#define JSON_POOL_UNLOCK(pool)
+#endif
+
+static void *json_load_worker(void *arg) {
+    json_load_pool_t *pool = (json_load_pool_t *)arg;
+
+    while (1) {
+        JSON_POOL_LOCK(pool);
+        size_t i = pool->next++;
+        JSON_POOL_UNLOCK(pool);
+
+        if (i >= pool->n)
+            break;
+
+        json_error_t *error = pool->errors ? &pool->errors[i] : NULL;
+
+        if (error) {
+            error->line = error->column = error->offset = 0;
+            error->message[0] = '\0';
+        }
+
+        if (!json_load_file_catch(
+            &pool->out[i], pool->paths[i], pool->arena, error
+        )) {
+            JSON_POOL_LOCK(pool);
+            ++pool->failed;
+            JSON_POOL_UNLOCK(pool);
+        }
+    }
+
+    return NULL;
+}
+
+size_t json_load_files(
+    const char **paths, size_t n, json_t *out, const json_load_opts_t *opts
+) {
+    json_load_pool_t pool;
+
+    pool.paths = paths;
+    pool.out = out;
+    pool.errors = opts ? opts->errors : NULL;
+    pool.arena = opts ? opts->arena : NULL;
+    pool.n = n;
+    pool.next = pool.failed = 0;
+
+#ifdef JSON_PTHREADS
+    size_t threads = opts ? opts->threads : 0;
+
+    if (!threads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cpus > 0 ? (size_t)cpus : 1;
+    }
+
+    if (threads > n)
+        threads = n;
+
+    // the calling thread works too, so start one less
+    pthread_t *workers = NULL;
+    size_t started = 0;
+
+    pthread_mutex_init(&pool.lock, NULL);
+
+    if (threads > 1) {
+        workers = (pthread_t *)JSON_MALLOC((threads - 1) * sizeof(*workers));
+
+        for (; started < threads - 1; ++started) {
+            // fewer threads is fine, the rest of the work still gets done
+            if (pthread_create(
+                &workers[started], NULL, json_load_worker, &pool
+            )) {
+                break;
+            }
+        }
+    }
+
+    json_load_worker(&pool);
+
+    for (size_t i = 0; i < started; ++i)
+        pthread_join(workers[i], NULL);
+
+    if (workers)
+        JSON_FREE(workers);
+
+    pthread_mutex_destroy(&pool.lock);
+#else
+    json_load_worker(&pool);
+#endif
+
+    return pool.failed;
+}
+
+// async loading ===============================================================
+// reads for many files are kept in flight with io_uring, and each file is
+// parsed as soon as its read completes, while the other reads carry on
+
+#ifdef JSON_URING
+#define JSON_ASYNC_DEPTH 32
+
+// io_uring reads are limited to 32-bit lengths, larger files take a few
+#define JSON_ASYNC_READ_MAX ((size_t)1 << 30)
+
+// a minimal io_uring, using the raw syscalls
+typedef struct json_uring {
+    int fd;
+
+    // submission queue
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned queued;
+
+    // completion queue
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len, sqes_len;
+} json_uring_t;
+
+// a file being read
+typedef struct json_async_read {
+    size_t index; // into paths
+    int fd;
+    char *text;
+    size_t len, done;
+    bool failed;
+    struct iovec iov;
+} json_async_read_t;
+
+static bool json_uring_init(json_uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+
+    if (ring->fd < 0)
+        return false;
+
+    ring->sq_map_len = params.sq_off.array
+        + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_len = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // newer kernels map both queues at once
+    bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (single_map && ring->cq_map_len > ring->sq_map_len)
+        ring->sq_map_len = ring->cq_map_len;
+
+    ring->sq_map = mmap(
+        NULL, ring->sq_map_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED, ring->fd, IORING_OFF_SQ_RING
+    );
+    ring->cq_map = single_map ? ring->sq_map : mmap(
+        NULL, ring->cq_map_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED, ring->fd, IORING_OFF_CQ_RING
+    );
+    ring->sqes = (struct io_uring_sqe *)mmap(
+        NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED, ring->fd, IORING_OFF_SQES
+    );
+
+    if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED
+     || ring->sqes == MAP_FAILED) {
+        if (ring->sq_map != MAP_FAILED)
+            munmap(ring->sq_map, ring->sq_map_len);
+        if (!single_map && ring->cq_map != MAP_FAILED)
+            munmap(ring->cq_map, ring->cq_map_len);
+        if (ring->sqes != MAP_FAILED)
+            munmap(ring->sqes, ring->sqes_len);
+
+        close(ring->fd);
+
+        return false;
+    }
+
+    char *sq = (char *)ring->sq_map, *cq = (char *)ring->cq_map;
+
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->queued = 0;
+
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+static void json_uring_kill(json_uring_t *ring) {
+    munmap(ring->sqes, ring->sqes_len);
+
+    if (ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_len);
+
+    munmap(ring->sq_map, ring->sq_map_len);
+    close(ring->fd);
+}
+
+// queues a read of the rest of a file, submitted by the next json_uring_enter
+static void json_uring_read(json_uring_t *ring, json_async_read_t *read) {
+    unsigned tail = *ring->sq_tail;
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[slot];
+    size_t len = read->len - read->done;
+
+    if (len > JSON_ASYNC_READ_MAX)
+        len = JSON_ASYNC_READ_MAX;
+
+    read->iov.iov_base = read->text + read->done;
+    read->iov.iov_len = len;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = read->fd;
+    sqe->off = read->done;
+    sqe->addr = (uint64_t)(uintptr_t)&read->iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)(uintptr_t)read;
+
+    ring->sq_array[slot] = slot;
+
+    // the kernel must see the entry before the new tail
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring->queued;
+}
+
+// submits queued reads, waiting until at least wait have completed
+static void json_uring_enter(json_uring_t *ring, unsigned wait) {
+    while (1) {
+        long res = syscall(
+            __NR_io_uring_enter, ring->fd, ring->queued, wait,
+            wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0
+        );
+
+        if (res >= 0) {
+            ring->queued -= (unsigned)res;
+
+            if (!ring->queued)
+                return;
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            JSON_ERROR("io_uring_enter failed: %s\n", strerror(errno));
+        }
+    }
+}
+
+// opens a file and queues its read, or loads it straight away if there is
+// nothing to read. returns false if the file was dealt with already
+static bool json_async_start(
+    json_uring_t *ring, json_async_read_t *read, json_load_pool_t *pool,
+    size_t index
+) {
+    json_t *json = &pool->out[index];
+    json_error_t *error = pool->errors ? &pool->errors[index] : NULL;
+    struct stat st;
+
+    if (error) {
+        error->line = error->column = error->offset = 0;
+        error->message[0] = '\0';
+    }
+
+    read->index = index;
+    read->fd = open(pool->paths[index], O_RDONLY);
+
+    if (read->fd < 0 || fstat(read->fd, &st) || !S_ISREG(st.st_mode)
+     || st.st_size <= 0) {
+        if (read->fd >= 0)
+            close(read->fd);
+
+        // empty and special files go the slow way
+        if (!json_load_file_catch(
+            json, pool->paths[index], pool->arena, error
+        )) {
+            ++pool->failed;
+        }
+
+        return false;
+    }
+
+    read->len = (size_t)st.st_size;
+    read->done = 0;
+    read->failed = false;
+    read->text = (char *)JSON_MALLOC(read->len + 1);
+
+    json_uring_read(ring, read);
+
+    return true;
+}
+
+// parses a file whose read is done
+static void json_async_finish(json_async_read_t *read, json_load_pool_t *pool) {
+    json_t *json = &pool->out[read->index];
+    json_error_t *error = pool->errors ? &pool->errors[read->index] : NULL;
+
+    close(read->fd);
+
+    if (read->failed) {
+        if (!json_open_failed(
+            json, pool->paths[read->index], pool->arena, error
+        )) {
+            ++pool->failed;
+        }
+    } else {
+        read->text[read->done] = '\0';
+
+        json_load_sized(json, read->done, pool->arena);
+
+        if (!json_parse(json, read->text, read->done, false, error))
+            ++pool->failed;
+    }
+
+    JSON_FREE(read->text);
+}
+#endif
+
+size_t json_async_load(
+    const char **paths, size_t n, json_t *out, const json_load_opts_t *opts
+) {
+#ifdef JSON_URING
+    size_t depth = opts && opts->queue_depth ? opts->queue_depth
+        : JSON_ASYNC_DEPTH;
+    json_uring_t ring;
+
+    if (depth > n)
+        depth = n;
+
+    if (depth && json_uring_init(&ring, (unsigned)depth)) {
+        json_load_pool_t pool;
+
+        pool.paths = paths;
+        pool.out = out;
+        pool.errors = opts ? opts->errors : NULL;
+        pool.arena = opts ? opts->arena : NULL;
+        pool.n = n;
+        pool.next = pool.failed = 0;
+
+        // reads are kept in slots, free slots are on a stack
+        json_async_read_t *reads = (json_async_read_t *)JSON_MALLOC(
+            depth * sizeof(*reads)
+        );
+        json_async_read_t **free_reads = (json_async_read_t **)JSON_MALLOC(
+            depth * sizeof(*free_reads)
+        );
+        json_async_read_t **done_reads = (json_async_read_t **)JSON_MALLOC(
+            depth * sizeof(*done_reads)
+        );
+        size_t num_free = depth;
+
+        for (size_t i = 0; i < depth; ++i)
+            free_reads[i] = &reads[i];
+
+        while (1) {
+            // fill the free slots with new reads
+            while (num_free && pool.next < n) {
+                json_async_read_t *read = free_reads[num_free - 1];
+
+                if (json_async_start(&ring, read, &pool, pool.next++))
+                    --num_free;
+            }
+
+            if (num_free == depth)
+                break;
+
+            json_uring_enter(&ring, 1);
+
+            // collect completed reads, rereading the rest of short reads
+            unsigned head = *ring.cq_head;
+            unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+            size_t num_done = 0;
+
+            for (; head != tail; ++head) {
+                struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+                json_async_read_t *read =
+                    (json_async_read_t *)(uintptr_t)cqe->user_data;
+
+                if (cqe->res > 0) {
+                    read->done += (size_t)cqe->res;
 
-        // read exponent
-        if (ctx->text[ctx->index] == '+' || ctx->text[ctx->index] == '-')
-            ++ctx->index;
+                    if (read->done < read->len) {
+                        json_uring_read(&ring, read);
+                        continue;
+                    }
+                }
 
-        if (!json_is_digit(ctx->text[ctx->index]))
-            JSON_CTX_ERROR(ctx, "expected digit.\n");
+                // the file may also have shrunk since it was opened, in which
+                // case what was read is parsed
+                read->failed = cqe->res < 0;
+                done_reads[num_done++] = read;
+            }
 
-        while (json_is_digit(ctx->text[ctx->index])) {
-            ++ctx->index;
+            __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+            // keep the disk busy while parsing
+            if (ring.queued)
+                json_uring_enter(&ring, 0);
+
+            for (size_t i = 0; i < num_done; ++i) {
+                json_async_finish(done_reads[i], &pool);
+                free_reads[num_free++] = done_reads[i];
+            }
         }
-    }
 
-    // number is valid json and accepted, can parse
-    char buf[128];
-    size_t length = ctx->index - start_index;
-    strncpy(buf, &ctx->text[start_index], length);
+        JSON_FREE(reads);
+        JSON_FREE(free_reads);
+        JSON_FREE(done_reads);
+        json_uring_kill(&ring);
+
+        return pool.failed;
+    }
+#endif
 
-    return atof(buf);
+    return json_load_files(paths, n, out, opts);
 }
 
-static json_object_t *json_expect_obj(json_ctx_t *, json_object_t *);
-static json_object_t *json_expect_array(json_ctx_t *, json_object_t *);
+// incremental parsing =========================================================
+// complete tokens are parsed straight out of each chunk. only the incomplete
+// token at the end of a chunk is copied, into the carry buffer, and finished
+// once the chunk containing its end arrives.
 
-// fills object in with value
-static void json_expect_value(json_ctx_t *ctx, json_object_t *object) {
-    switch (ctx->text[ctx->index]) {
-    case '{':
-        json_expect_obj(ctx, object);
-        object->type = JSON_OBJECT;
+#define JSON_INIT_CARRY_CAP 256
 
-        break;
+static bool json_is_separator(char ch) {
+    switch (ch) {
+    case ' ':
+    case '\n':
+    case '\r':
+    case '\t':
+    case '{':
+    case '}':
     case '[':
-        json_expect_array(ctx, object);
-        object->type = JSON_ARRAY;
+    case ']':
+    case ':':
+    case ',':
+        return true;
+    default:
+        return false;
+    }
+}
 
-        break;
-    case '"':
-        object->data.string = json_expect_string(ctx);
-        object->type = JSON_STRING;
+// finds the first and last separators outside of strings in chunk, which are
+// where complete tokens end. the last separator is only looked for before the
+// final byte, so there is always a byte after it to peek at. both are len if
+// not found
+static void json_feed_scan(
+    json_parser_t *parser, const char *chunk, size_t len,
+    size_t *out_first, size_t *out_last
+) {
+    size_t first = len, last = len;
+
+    for (size_t i = 0; i < len; ++i) {
+        char ch = chunk[i];
+
+        if (parser->in_string) {
+            if (parser->escaped) {
+                parser->escaped = false;
+            } else if (ch == '\\') {
+                parser->escaped = true;
+            } else if (ch == '\"') {
+                parser->in_string = false;
+            } else {
+                // skip plain string characters in bulk
+                size_t run = json_string_run(chunk + i, len - i);
+
+                if (run)
+                    i += run - 1;
+            }
+        } else if (ch == '\"') {
+            parser->in_string = true;
+        } else if (json_is_separator(ch)) {
+            if (first == len)
+                first = i;
+
+            if (i + 1 < len)
+                last = i;
+        }
+    }
 
-        break;
+    *out_first = first;
+    *out_last = last;
+}
+
+static void json_carry_append(
+    json_parser_t *parser, const char *text, size_t len
+) {
+    // + 1 for the null terminator
+    if (parser->carry_len + len + 1 > parser->carry_cap) {
+        if (!parser->carry_cap)
+            parser->carry_cap = JSON_INIT_CARRY_CAP;
+
+        while (parser->carry_len + len + 1 > parser->carry_cap)
+            parser->carry_cap <<= 1;
+
+        parser->carry = (char *)json_fat_realloc(
+            &parser->json->allocator,
+            parser->carry,
+            parser->carry_cap
+        );
+    }
+
+    memcpy(parser->carry + parser->carry_len, text, len);
+    parser->carry_len += len;
+    parser->carry[parser->carry_len] = '\0';
+}
+
+// parses the tokens in text which start from index and before limit
+static void json_feed_run(
+    json_parser_t *parser, const char *text, size_t index, size_t len,
+    size_t limit
+) {
+    json_ctx_t ctx;
+
+    ctx.json = parser->json;
+    ctx.allocator = &parser->json->allocator;
+    ctx.text = text;
+    ctx.index = index;
+    ctx.len = len;
+    ctx.idx = NULL;
+    ctx.insitu = false;
+    ctx.error = NULL;
+    ctx.embedded = ctx.lazy = false;
+    ctx.base_depth = ctx.span_count = 0;
+    ctx.spans = NULL;
+    ctx.state = (json_state_e)parser->state;
+    ctx.object = parser->object;
+    ctx.stack = parser->stack;
+    ctx.depth = parser->depth;
+    ctx.stack_cap = parser->stack_cap;
+    ctx.items = parser->items;
+    ctx.item_count = parser->item_count;
+    ctx.item_cap = parser->item_cap;
+
+    json_run(&ctx, limit);
+
+    // the json ends at the null terminator, like json_parse_n() nothing may
+    // follow it
+    if (ctx.state == JSON_STATE_DONE && ctx.index < len)
+        JSON_CTX_ERROR(&ctx, "unexpected null character.\n");
+
+    parser->state = ctx.state;
+    parser->object = ctx.object;
+    parser->stack = ctx.stack;
+    parser->depth = ctx.depth;
+    parser->stack_cap = ctx.stack_cap;
+    parser->items = ctx.items;
+    parser->item_count = ctx.item_count;
+    parser->item_cap = ctx.item_cap;
+}
+
+void json_parser_init_ex(
+    json_parser_t *parser, json_t *json, const json_arena_opts_t *opts
+) {
+    json_load_empty_ex(json, opts);
+
+    parser->json = json;
+    parser->state = JSON_STATE_ROOT;
+    parser->object = NULL;
+    parser->stack = NULL;
+    parser->depth = parser->stack_cap = 0;
+    parser->items = NULL;
+    parser->item_count = parser->item_cap = 0;
+    parser->carry = NULL;
+    parser->carry_len = parser->carry_cap = 0;
+    parser->in_string = parser->escaped = false;
+}
+
+void json_parser_init(json_parser_t *parser, json_t *json) {
+    json_parser_init_ex(parser, json, NULL);
+}
+
+void json_feed(json_parser_t *parser, const char *chunk, size_t len) {
+    size_t first, last;
+
+    if (parser->state == JSON_STATE_DONE && len)
+        JSON_ERROR("unexpected text after the end of json.\n");
+
+    json_feed_scan(parser, chunk, len, &first, &last);
+
+    if (first == len) {
+        // the whole chunk is part of one token
+        json_carry_append(parser, chunk, len);
+        return;
+    }
+
+    size_t start = 0;
+
+    if (parser->carry_len) {
+        // finish the carried token, the separator after it is only peeked at
+        json_carry_append(parser, chunk, first + 1);
+        json_feed_run(
+            parser,
+            parser->carry,
+            0,
+            parser->carry_len,
+            parser->carry_len - 1
+        );
+
+        parser->carry_len = 0;
+        start = first;
+    }
+
+    if (last != len) {
+        json_feed_run(parser, chunk, start, last + 1, last);
+        start = last;
+    }
+
+    json_carry_append(parser, chunk + start, len - start);
+}
+
+void json_finish(json_parser_t *parser) {
+    // the null terminator is parsed as the final token
+    json_carry_append(parser, "", 0);
+    json_feed_run(
+        parser,
+        parser->carry,
+        0,
+        parser->carry_len,
+        parser->carry_len + 1
+    );
+
+    json_parser_free(parser);
+}
+
+void json_parser_free(json_parser_t *parser) {
+    const json_allocator_t *a = &parser->json->allocator;
+
+    if (parser->carry)
+        json_fat_free(a, parser->carry);
+
+    if (parser->stack)
+        json_fat_free(a, parser->stack);
+
+    if (parser->items)
+        json_fat_free(a, parser->items);
+
+    parser->carry = NULL;
+    parser->stack = NULL;
+    parser->items = NULL;
+    parser->carry_len = parser->carry_cap = 0;
+    parser->stack_cap = parser->item_cap = 0;
+}
+
+// sax parsing =================================================================
+// events are emitted straight from the tokenizer. strings without escapes are
+// passed as pointers into the text, and the rest are decoded into one reusable
+// scratch buffer, so nothing is allocated per value.
+
+#define JSON_INIT_SCRATCH_CAP 256
+
+typedef struct json_sax {
+    json_ctx_t ctx;
+    const json_sax_handler_t *handler;
+    void *user;
+
+    char *scratch; // fat pointer, decoded strings with escapes
+    size_t scratch_cap;
+
+    // one bit per open container, set for objects
+    uint64_t kinds[JSON_MAX_DEPTH / 64 + 1];
+} json_sax_t;
+
+static void json_sax_reserve(json_sax_t *sax, size_t size) {
+    if (size <= sax->scratch_cap)
+        return;
+
+    if (!sax->scratch_cap)
+        sax->scratch_cap = JSON_INIT_SCRATCH_CAP;
+
+    while (size > sax->scratch_cap)
+        sax->scratch_cap <<= 1;
+
+    sax->scratch = (char *)json_fat_realloc(
+        sax->ctx.allocator, sax->scratch, sax->scratch_cap
+    );
+}
+
+// returns the string at the current index without allocating, its length is
+// stored in out_len. the string is not null terminated. if decode is false the
+// string is only checked, and NULL is returned for strings with escapes
+static const char *json_sax_string(
+    json_sax_t *sax, size_t *out_len, bool decode
+) {
+    json_ctx_t *ctx = &sax->ctx;
+
+    if (ctx->text[ctx->index++] != '\"')
+        JSON_CTX_ERROR(ctx, "unknown token, expected string.\n");
+
+    const char *str = ctx->text + ctx->index;
+    size_t length = json_string_run(str, ctx->len - ctx->index);
+
+    ctx->index += length;
+
+    // without escapes the string is left pointing into the text, otherwise it
+    // is decoded into scratch
+    if (ctx->text[ctx->index] != '\"') {
+        if (decode) {
+            // + 4 leaves room for a decoded escape
+            json_sax_reserve(sax, length + 4);
+            memcpy(sax->scratch, str, length);
+        }
+
+        while (1) {
+            char ch = ctx->text[ctx->index];
+
+            if (ch == '\"') {
+                break;
+            } else if (ch == '\\') {
+                char escaped[4];
+
+                length += json_expect_escape(
+                    ctx, decode ? sax->scratch + length : escaped
+                );
+            } else if (ch == '\0' || ch == '\n' || ctx->index >= ctx->len)
+                JSON_CTX_ERROR(ctx, "string ended unexpectedly.\n");
+            else
+                JSON_CTX_ERROR(ctx, "unescaped control character in string.\n");
+
+            // copy plain characters in bulk
+            size_t run = json_string_run(
+                ctx->text + ctx->index,
+                ctx->len - ctx->index
+            );
+
+            if (decode) {
+                json_sax_reserve(sax, length + run + 4);
+                memcpy(sax->scratch + length, ctx->text + ctx->index, run);
+            }
+
+            length += run;
+            ctx->index += run;
+        }
+
+        str = decode ? sax->scratch : NULL;
+    }
+
+    ++ctx->index; // skip ending double quote
+
+    json_expect_terminator(ctx);
+
+    *out_len = length;
+
+    return str;
+}
+
+// emits a scalar value, returns false if the handler aborted
+static bool json_sax_scalar(json_sax_t *sax) {
+    json_ctx_t *ctx = &sax->ctx;
+    const json_sax_handler_t *handler = sax->handler;
+
+    switch (ctx->text[ctx->index]) {
+    case '"': {
+        size_t length;
+        const char *str = json_sax_string(sax, &length, handler->string);
+
+        return !handler->string || handler->string(sax->user, str, length);
+    }
     case 't':
         json_expect_token(ctx, "true", 4);
-        object->type = JSON_TRUE;
+        json_expect_terminator(ctx);
 
-        break;
+        return !handler->boolean || handler->boolean(sax->user, true);
     case 'f':
         json_expect_token(ctx, "false", 5);
-        object->type = JSON_FALSE;
+        json_expect_terminator(ctx);
 
-        break;
+        return !handler->boolean || handler->boolean(sax->user, false);
     case 'n':
         json_expect_token(ctx, "null", 4);
-        object->type = JSON_NULL;
+        json_expect_terminator(ctx);
 
-        break;
+        return !handler->null || handler->null(sax->user);
     default:;
-        // could be number
-        if (json_is_digit(ctx->text[ctx->index])
-         || ctx->text[ctx->index] == '-') {
-            object->data.number = json_expect_number(ctx);
-            object->type = JSON_NUMBER;
+        if (!json_is_digit(ctx->text[ctx->index])
+         && ctx->text[ctx->index] != '-')
+            JSON_CTX_ERROR(ctx, "unknown token, expected value.\n");
+
+        json_object_t number;
+
+        if (!handler->number && !handler->integer) {
+            json_expect_number(ctx, NULL);
+
+            return true;
+        }
+
+        json_expect_number(ctx, &number);
+
+        if (number.type == JSON_INTEGER) {
+            if (handler->integer)
+                return handler->integer(sax->user, number.data.integer);
+
+            number.data.number = (double)number.data.integer;
+        }
+
+        return !handler->number
+            || handler->number(sax->user, number.data.number);
+    }
+}
+
+// opens an object or array, returns false if the handler aborted
+static bool json_sax_open(json_sax_t *sax, char ch) {
+    json_ctx_t *ctx = &sax->ctx;
+    const json_sax_handler_t *handler = sax->handler;
+    uint64_t bit = (uint64_t)1 << (ctx->depth & 63);
+
+    if (ctx->depth == JSON_MAX_DEPTH)
+        JSON_CTX_ERROR(ctx, "exceeded maximum depth of %d.\n", JSON_MAX_DEPTH);
+
+    ++ctx->index; // skip '{' or '['
+
+    if (ch == '{') {
+        sax->kinds[ctx->depth++ >> 6] |= bit;
+
+        return !handler->start_object || handler->start_object(sax->user);
+    } else {
+        sax->kinds[ctx->depth++ >> 6] &= ~bit;
+
+        return !handler->start_array || handler->start_array(sax->user);
+    }
+}
+
+// same grammar as json_run, emitting events instead of building objects. stops
+// when done, or when the next token starts at or after limit
+static bool json_sax_run(json_sax_t *sax, size_t limit) {
+    json_ctx_t *ctx = &sax->ctx;
+    const json_sax_handler_t *handler = sax->handler;
+
+    while (ctx->state != JSON_STATE_DONE) {
+        json_next_token(ctx);
+
+        if (ctx->index >= limit)
+            return true;
+
+        char ch = ctx->text[ctx->index];
+
+        switch (ctx->state) {
+        case JSON_STATE_ROOT:
+            if (ch == '\0' && ctx->index == ctx->len) {
+                // empty json is still valid json
+                ctx->state = JSON_STATE_DONE;
+            } else if (ch == '{' || ch == '[') {
+                ctx->state = JSON_STATE_VALUE;
+            } else {
+                JSON_CTX_ERROR(ctx, "invalid json root.\n");
+            }
+
+            break;
+        case JSON_STATE_VALUE:
+            if (ch == '{' || ch == '[') {
+                if (!json_sax_open(sax, ch))
+                    return false;
+
+                ctx->state = JSON_STATE_OPENED;
+            } else {
+                if (!json_sax_scalar(sax))
+                    return false;
+
+                ctx->state = ctx->depth ? JSON_STATE_NEXT : JSON_STATE_END;
+            }
+
+            break;
+        case JSON_STATE_OPENED:
+        case JSON_STATE_NEXT: {
+            size_t top = ctx->depth - 1;
+            bool is_obj = (sax->kinds[top >> 6] >> (top & 63)) & 1;
+
+            if (ch == (is_obj ? '}' : ']')) {
+                ++ctx->index;
+                --ctx->depth;
+
+                bool (*end)(void *) = is_obj
+                    ? handler->end_object
+                    : handler->end_array;
+
+                if (end && !end(sax->user))
+                    return false;
+
+                ctx->state = ctx->depth ? JSON_STATE_NEXT : JSON_STATE_END;
+
+                break;
+            }
+
+            if (ctx->state == JSON_STATE_NEXT)
+                json_expect_token(ctx, ",", 1);
+
+            ctx->state = is_obj ? JSON_STATE_KEY : JSON_STATE_VALUE;
 
             break;
         }
+        case JSON_STATE_KEY: {
+            size_t length;
+            const char *key = json_sax_string(sax, &length, handler->key);
 
-        JSON_CTX_ERROR(ctx, "unknown token, expected value.\n");
+            if (handler->key && !handler->key(sax->user, key, length))
+                return false;
+
+            ctx->state = JSON_STATE_COLON;
+
+            break;
+        }
+        case JSON_STATE_COLON:
+            json_expect_token(ctx, ":", 1);
+            ctx->state = JSON_STATE_VALUE;
+
+            break;
+        case JSON_STATE_END:
+            if (ch == '\0' && ctx->index < ctx->len)
+                JSON_CTX_ERROR(ctx, "unexpected null character.\n");
+
+            json_expect_token(ctx, "", 1);
+            ctx->state = JSON_STATE_DONE;
+
+            break;
+        case JSON_STATE_DONE:
+            break;
+        }
     }
+
+    return true;
 }
 
-static json_object_t *json_expect_array(
-    json_ctx_t *ctx, json_object_t *object
+bool json_sax_parse(
+    const char *text, size_t len, const json_sax_handler_t *handler,
+    void *user
 ) {
-    json_vec_t *vec = (json_vec_t *)json_page_alloc(ctx->json, sizeof(*vec));
-    json_vec_make(ctx->json, vec, JSON_VEC_INIT_CAP);
+    json_sax_t sax;
+    json_index_t idx;
 
-    object->data.vec = vec;
+    json_ctx_make(&sax.ctx, NULL, text, len, &idx);
 
-    ++ctx->index; // skip '['
+    sax.handler = handler;
+    sax.user = user;
+    sax.scratch = NULL;
+    sax.scratch_cap = 0;
 
-    // check for empty array
-    json_next_token(ctx);
+    // the null terminator is parsed as the final token
+    bool finished = json_sax_run(&sax, len + 1);
 
-    if (ctx->text[ctx->index] == ']') {
-        ++ctx->index;
+    if (sax.scratch)
+        json_fat_free(sax.ctx.allocator, sax.scratch);
+
+    json_ctx_kill(&sax.ctx);
+
+    return finished;
+}
+
+// sax parsing without any callbacks, so strings aren't decoded and numbers
+// aren't converted. text is parsed in place the same way as json_parse_n
+bool json_validate(const char *text, size_t len, json_error_t *error) {
+    json_sax_handler_t handler;
+    json_error_t ignored;
+    json_sax_t sax;
+    jmp_buf jmp;
+    size_t end = len;
+
+    while (end && json_is_whitespace(text[end - 1]))
+        --end;
+
+    // empty json is still valid json
+    if (!end)
+        return true;
 
-        return object;
+    memset(&handler, 0, sizeof(handler));
+
+    // a bracket ends any token before it, so parsing in place up to the last
+    // bracket never reads past len
+    size_t last = end - 1;
+
+    while (last && text[last] != '{' && text[last] != '}'
+                && text[last] != '[' && text[last] != ']')
+        --last;
+
+    json_ctx_make(&sax.ctx, NULL, text, last, NULL);
+    sax.ctx.error = error ? error : &ignored;
+    sax.ctx.jmp = &jmp;
+    sax.handler = &handler;
+    sax.user = NULL;
+    sax.scratch = NULL;
+    sax.scratch_cap = 0;
+
+    // set once only the tail copy is left to parse
+    volatile bool in_tail = false;
+
+    if (setjmp(jmp)) {
+        // locate the error in text rather than tail
+        if (in_tail)
+            json_error_locate(sax.ctx.error, text, last);
+
+        json_ctx_kill(&sax.ctx);
+
+        return false;
     }
 
-    // parse key/value pairs
-    while (1) {
-        // get child and store
-        json_object_t *child = (json_object_t *)json_page_alloc(
-            ctx->json,
-            sizeof(*child)
-        );
+    json_sax_run(&sax, last);
+
+    if (sax.ctx.state == JSON_STATE_ROOT) {
+        // the root was never reached, so the only bracket is at its start
+        while (json_is_whitespace(text[sax.ctx.index]))
+            ++sax.ctx.index;
+
+        if (text[sax.ctx.index] != '{' && text[sax.ctx.index] != '[')
+            JSON_CTX_ERROR(&sax.ctx, "invalid json root.\n");
+    }
+
+    if (last != end - 1 || (text[last] != '}' && text[last] != ']')) {
+        // json always ends with the root's closing bracket
+        sax.ctx.index = end - 1;
+        JSON_CTX_ERROR(&sax.ctx, "expected json to end with '}' or ']'.\n");
+    }
+
+    char tail[2] = {text[last], '\0'};
+
+    sax.ctx.text = tail;
+    sax.ctx.index = 0;
+    sax.ctx.len = 1;
+    in_tail = true;
+
+    json_sax_run(&sax, 2);
+    json_ctx_kill(&sax.ctx);
+
+    return true;
+}
+
+// json lines ==================================================================
+
+void json_lines_open_buffer(
+    json_lines_t *reader, const char *text, size_t len
+) {
+    reader->text = text;
+    reader->len = len;
+    reader->index = reader->line = 0;
+    reader->owned = NULL;
+    reader->owned_len = 0;
+    reader->mapped = false;
+}
+
+void json_lines_open(json_lines_t *reader, const char *filepath) {
+    size_t len;
+
+#ifdef JSON_MMAP
+    size_t map_len;
+    char *mapped = json_map_file(filepath, &len, &map_len);
+
+    if (mapped) {
+        json_lines_open_buffer(reader, mapped, len);
+        reader->owned = mapped;
+        reader->owned_len = map_len;
+        reader->mapped = true;
+
+        return;
+    }
+#endif
+
+    FILE *file = fopen(filepath, "rb");
+
+    if (!file)
+        JSON_ERROR("could not open file: \"%s\"\n", filepath);
+
+    char *text = json_read_file(file, &len);
+
+    fclose(file);
+
+    json_lines_open_buffer(reader, text, len);
+    reader->owned = text;
+}
+
+json_lines_status_e json_lines_next(json_lines_t *reader, json_t *json) {
+    while (reader->index < reader->len) {
+        const char *start = reader->text + reader->index;
+        size_t len = reader->len - reader->index;
+        const char *newline = (const char *)memchr(start, '\n', len);
+
+        if (newline) {
+            len = (size_t)(newline - start);
+            reader->index += len + 1;
+        } else {
+            reader->index = reader->len;
+        }
+
+        ++reader->line;
+
+        // skip blank lines
+        size_t i = 0;
+
+        while (i < len && json_is_whitespace(start[i]))
+            ++i;
+
+        if (i == len)
+            continue;
+
+        // reuse the memory from the last record
+        json_reset(json);
+
+        if (!json_parse_n(json, start, len, &reader->error)) {
+            reader->error.line = reader->line;
+
+            return JSON_LINES_ERROR;
+        }
+
+        return JSON_LINES_OK;
+    }
+
+    return JSON_LINES_END;
+}
+
+void json_lines_close(json_lines_t *reader) {
+    if (!reader->owned)
+        return;
+
+#ifdef JSON_MMAP
+    if (reader->mapped) {
+        munmap(reader->owned, reader->owned_len);
+        reader->owned = NULL;
+
+        return;
+    }
+#endif
+
+    JSON_FREE(reader->owned);
+    reader->owned = NULL;
+}
+
+// json array streams ==========================================================
+// mapped files are parsed in place, giving pages back to the os once they have
+// been parsed. anything else is read in chunks, only keeping the text from the
+// current element on
 
-        json_expect_value(ctx, child);
+// minimum fread() size when reading a stream in chunks
+#define JSON_STREAM_CHUNK 65536
 
-        json_vec_push(ctx->json, vec, child);
+// parsed pages of mapped files are given back this many bytes at a time
+#define JSON_STREAM_RELEASE ((size_t)1 << 20)
 
-        // iterate
-        json_next_token(ctx);
+void json_array_stream_open(json_array_stream_t *stream, const char *filepath) {
+    stream->index = stream->released = 0;
+    stream->mapped = stream->started = stream->ended = false;
+    stream->file = NULL;
 
-        if (ctx->text[ctx->index] == ']') {
-            ++ctx->index;
-            break;
-        }
+#ifdef JSON_MMAP
+    stream->text = json_map_file(filepath, &stream->len, &stream->map_len);
 
-        json_expect_token(ctx, ",", 1);
-        json_next_token(ctx);
+    if (stream->text) {
+        stream->mapped = true;
+        return;
     }
+#endif
 
-    return object;
+    stream->file = fopen(filepath, "rb");
+
+    if (!stream->file)
+        JSON_ERROR("could not open file: \"%s\"\n", filepath);
+
+    stream->cap = JSON_STREAM_CHUNK + 1;
+    stream->text = (char *)JSON_MALLOC(stream->cap);
+    stream->text[0] = '\0';
+    stream->len = 0;
 }
 
-static json_object_t *json_expect_obj(json_ctx_t *ctx, json_object_t *object) {
-    json_hmap_t *hmap = (json_hmap_t *)json_page_alloc(
-        ctx->json,
-        sizeof(*hmap)
-    );
-    json_hmap_make(ctx->json, hmap, JSON_HMAP_INIT_CAP);
+// drops the text before index and reads at least as much again as is left.
+// returns false if the whole file has already been read
+static bool json_array_stream_read(json_array_stream_t *stream) {
+    if (!stream->file)
+        return false;
 
-    object->data.hmap = hmap;
+    size_t keep = stream->len - stream->index;
+    size_t want = keep > JSON_STREAM_CHUNK ? keep : JSON_STREAM_CHUNK;
 
-    ++ctx->index; // skip '{'
+    memmove(stream->text, stream->text + stream->index, keep);
 
-    // check for empty object
-    json_next_token(ctx);
+    if (keep + want + 1 > stream->cap) {
+        while (keep + want + 1 > stream->cap)
+            stream->cap <<= 1;
 
-    if (ctx->text[ctx->index] == '}') {
-        ++ctx->index;
+        char *grown = (char *)JSON_MALLOC(stream->cap);
 
-        return object;
+        memcpy(grown, stream->text, keep);
+        JSON_FREE(stream->text);
+
+        stream->text = grown;
     }
 
-    // parse key/value pairs
-    while (1) {
-        // get pair and store
-        json_object_t *child = (json_object_t *)json_page_alloc(
-            ctx->json,
-            sizeof(*object)
-        );
+    size_t num_read = fread(stream->text + keep, 1, want, stream->file);
 
-        char *key = json_expect_string(ctx);
+    stream->index = 0;
+    stream->len = keep + num_read;
+    stream->text[stream->len] = '\0';
 
-        json_next_token(ctx);
-        json_expect_token(ctx, ":", 1);
-        json_next_token(ctx);
-        json_expect_value(ctx, child);
+    if (num_read < want) {
+        fclose(stream->file);
+        stream->file = NULL;
+    }
 
-        json_hmap_put(ctx->json, hmap, key, child);
+    return true;
+}
 
-        // iterate
-        json_next_token(ctx);
+// skips whitespace, returning the next char or '\0' at the end of the text
+static char json_array_stream_peek(json_array_stream_t *stream) {
+    while (1) {
+        stream->index += json_whitespace_run(
+            stream->text + stream->index,
+            stream->len - stream->index
+        );
 
-        if (ctx->text[ctx->index] == '}') {
-            ++ctx->index;
-            break;
+        if (stream->index < stream->len
+         || !json_array_stream_read(stream)) {
+            return stream->text[stream->index];
         }
-
-        json_expect_token(ctx, ",", 1);
-        json_next_token(ctx);
     }
-
-    return object;
 }
 
-static void json_parse(json_t *json, const char *text) {
+static void json_array_stream_error(
+    json_array_stream_t *stream, const char *message
+) {
     json_ctx_t ctx;
 
-    ctx.json = json;
-    ctx.text = text;
-    ctx.index = 0;
+    json_ctx_make(&ctx, NULL, stream->text, stream->len, NULL);
+    ctx.index = stream->index;
 
-    // recursive parse at root
-    json_next_token(&ctx);
+    JSON_CTX_ERROR(&ctx, "%s", message);
+}
 
-    switch (ctx.text[ctx.index]) {
-    case '{':
-        json->root = (json_object_t *)json_page_alloc(
-            ctx.json,
-            sizeof(*json->root)
-        );
+// checks that nothing but whitespace follows the array
+static void json_array_stream_end(json_array_stream_t *stream) {
+    json_ctx_t ctx;
 
-        json_expect_obj(&ctx, json->root);
-        json->root->type = JSON_OBJECT;
+    json_array_stream_peek(stream);
 
-        json_next_token(&ctx);
-        json_expect_token(&ctx, "", 1);
+    json_ctx_make(&ctx, NULL, stream->text, stream->len, NULL);
+    ctx.index = stream->index;
+    ctx.state = JSON_STATE_END;
 
-        break;
-    case '[':
-        json->root = (json_object_t *)json_page_alloc(
-            ctx.json,
-            sizeof(*json->root)
-        );
+    json_run(&ctx, stream->len + 1);
 
-        json_expect_array(&ctx, json->root);
-        json->root->type = JSON_ARRAY;
+    stream->ended = true;
+}
 
-        json_next_token(&ctx);
-        json_expect_token(&ctx, "", 1);
+// whether the element at index ends before the end of the text read so far,
+// in which case reading more can't fix an error in it. only brackets and
+// strings are followed, the element is parsed properly elsewhere
+static bool json_array_stream_complete(json_array_stream_t *stream) {
+    const char *text = stream->text;
+    size_t i = stream->index, len = stream->len, depth = 0;
 
-        break;
-    case '\0': // empty json is still valid json
-        json->root = NULL;
+    if (text[i] != '{' && text[i] != '[' && text[i] != '\"') {
+        // a literal or number ends at a separator
+        while (i < len && !strchr(" \t\r\n,]}", text[i]))
+            ++i;
 
-        break;
-    default:
-        JSON_CTX_ERROR(&ctx, "invalid json root.\n");
+        return i < len;
     }
-}
-
-// lifetime api ================================================================
 
-void json_load_empty(json_t *json) {
-    json->root = NULL;
+    while (1) {
+        i += json_bracket_run(text + i, len - i);
 
-    // page allocator
-    json->cur_page = json->used = 0;
-    json->page_cap = JSON_INIT_PAGE_CAP;
-    json->pages = (char **)json_fat_alloc(
-        json->page_cap * sizeof(*json->pages)
-    );
+        if (i >= len)
+            return false;
 
-    json->pages[0] = (char *)JSON_MALLOC(JSON_PAGE_SIZE);
+        if (text[i] == '\"') {
+            for (++i; i < len && text[i] != '\"'; ++i)
+                if (text[i] == '\\')
+                    ++i;
 
-    // tracking allocator
-    json->cur_tracked = 0;
-    json->tracked_cap = JSON_INIT_TRACKED_CAP;
-    json->tracked = (json_tptr_t **)json_fat_alloc(
-        json->tracked_cap * sizeof(*json->tracked)
-    );
+            if (i >= len)
+                return false;
+        } else if (text[i] == '{' || text[i] == '[') {
+            ++depth;
+        } else {
+            --depth;
+        }
 
-    JSON_DEBUG("tracked size %zu.\n", *((size_t *)json->tracked - 1));
+        ++i;
 
-    for (size_t i = 0; i < json->tracked_cap; ++i)
-        json->tracked[i] = NULL;
+        if (!depth)
+            return true;
+    }
 }
 
-static void json_parse(json_t *json, const char *text);
+bool json_array_stream_next(json_array_stream_t *stream, json_t *json) {
+    if (stream->ended)
+        return false;
 
-void json_load(json_t *json, char *text) {
-    json_load_empty(json);
-    json_parse(json, text);
-}
+    char ch = json_array_stream_peek(stream);
 
-void json_load_file(json_t *json, const char *filepath) {
-    JSON_DEBUG("reading\n");
+    if (!stream->started) {
+        if (ch == '\0' && stream->index == stream->len) {
+            // empty json, which has no elements
+            stream->ended = true;
+            return false;
+        } else if (ch != '[') {
+            json_array_stream_error(
+                stream, "invalid json root, expected array.\n"
+            );
+        }
 
-    // open and check for existance
-    FILE *file = fopen(filepath, "r");
+        ++stream->index;
+        stream->started = true;
 
-    if (!file)
-        JSON_ERROR("could not open file: \"%s\"\n", filepath);
+        if (json_array_stream_peek(stream) == ']') {
+            ++stream->index;
+            json_array_stream_end(stream);
 
-    // read text through buffer
-    char *text = NULL;
-    char *buffer = (char *)JSON_MALLOC(JSON_FREAD_BUF_SIZE);
-    size_t text_len = 0;
-    bool done = false;
+            return false;
+        }
+    } else if (ch == ']') {
+        ++stream->index;
+        json_array_stream_end(stream);
 
-    do {
-        size_t num_read = fread(
-            buffer,
-            sizeof(*buffer),
-            JSON_FREAD_BUF_SIZE,
-            file
-        );
+        return false;
+    } else if (ch == ',') {
+        ++stream->index;
+        json_array_stream_peek(stream);
+    } else {
+        json_array_stream_error(stream, "unknown token, expected \",\".\n");
+    }
 
-        if (num_read != JSON_FREAD_BUF_SIZE) {
-            done = true;
-            ++num_read;
-        }
+    bool complete = false;
 
-        // copy buffer into doc->text
-        size_t last_len = text_len;
+    while (1) {
+        json_ctx_t ctx;
+        json_error_t error;
 
-        text_len += num_read;
-        text = (char *)json_fat_realloc(text, text_len);
+        // reuse the memory from the last element
+        json_reset(json);
 
-        memcpy(text + last_len, buffer, num_read * sizeof(*buffer));
-    } while (!done);
+        json_ctx_make(&ctx, json, stream->text, stream->len, NULL);
+        ctx.index = stream->index;
+        ctx.embedded = true;
+        ctx.state = JSON_STATE_VALUE;
+        ctx.object = json->root = json_new_slot(&ctx);
 
-    text[text_len - 1] = '\0';
+        // while there is more to read, an error may just mean the element is
+        // cut off. the last attempt, or one on the whole element, exits with
+        // the error as usual
+        ctx.error = stream->file && !complete ? &error : NULL;
 
-    free(buffer);
+        bool parsed = json_run_catch(&ctx, stream->len + 1);
+        size_t end = ctx.index;
 
-    // load and cleanup
-    JSON_DEBUG("loading\n");
+        json_ctx_kill(&ctx);
+
+        // a number at the very end of the text could also continue past it
+        if (parsed && (end < stream->len || !stream->file)) {
+            stream->index = end;
+            break;
+        }
 
-    json_load(json, text);
+        // rather than reading the rest of the file first, the error in an
+        // element which has been read through is reported straight away
+        if (!parsed && json_array_stream_complete(stream)) {
+            complete = true;
+            continue;
+        }
 
-    json_fat_free(text);
-    fclose(file);
-}
+        json_array_stream_read(stream);
+    }
 
-// recursively free object hashmap and array vectors
-void json_unload(json_t *json) {
-    // free pages
-    for (size_t i = 0; i <= json->cur_page; ++i)
-        JSON_FREE(json->pages[i]);
+#if defined(JSON_MMAP) && defined(MADV_DONTNEED)
+    if (stream->mapped
+     && stream->index - stream->released >= JSON_STREAM_RELEASE) {
+        size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        size_t release = stream->index / page_size * page_size;
+
+        madvise(
+            stream->text + stream->released, release - stream->released,
+            MADV_DONTNEED
+        );
+        stream->released = release;
+    }
+#endif
+
+    return true;
+}
 
-    json_fat_free(json->pages);
+void json_array_stream_close(json_array_stream_t *stream) {
+#ifdef JSON_MMAP
+    if (stream->mapped) {
+        munmap(stream->text, stream->map_len);
+        return;
+    }
+#endif
 
-    // free tracked
-    for (size_t i = 0; i <= json->cur_tracked; ++i)
-        if (json->tracked[i])
-            JSON_FREE(json->tracked[i]);
+    if (stream->file)
+        fclose(stream->file);
 
-    json_fat_free(json->tracked);
+    JSON_FREE(stream->text);
 }
 
 // serialization api ===========================================================
@@ -1133,81 +4643,163 @@ void json_unload(json_t *json) {
 #define JSON_SERIALIZER_BUF_SIZE 1024
 #endif
 
-#define JSON_STRINGY_INIT_CAP 256
+// initial size of json_serialize()'s output buffer
+#define JSON_SERIALIZE_INIT_CAP 256
 
-// string builder
-typedef struct json_stringy {
-    char *str;
-    size_t pos, cap;
-} json_stringy_t;
+// size of json_serialize_to()'s output buffer, which is flushed when full
+#ifndef JSON_WRITE_BUF_SIZE
+#define JSON_WRITE_BUF_SIZE 4096
+#endif
 
 // serialization context
 typedef struct json_serializer {
-    json_stringy_t stringy;
-    char *buf;
+    // output buffer, which grows unless there is a writer to flush it to or
+    // it is fixed
+    char *out;
+    size_t pos, cap;
+    json_writer_fn write;
+    void *user;
+    bool failed; // the writer returned false
+    bool fixed, truncated;
+    size_t written; // chars which fit in a fixed buffer that was truncated
+
+    char buf[JSON_SERIALIZER_BUF_SIZE];
     int level;
 
     int indent, nlwidth;
     bool mini;
 } json_serializer_t;
 
-static void json_stringy_make(json_stringy_t *stringy) {
-    stringy->cap = JSON_STRINGY_INIT_CAP;
-    stringy->str = (char *)json_fat_alloc(stringy->cap);
-    stringy->pos = 0;
-}
+static void json_serialize_flush(json_serializer_t *ser_ctx) {
+    if (ser_ctx->pos && !ser_ctx->failed) {
+        ser_ctx->failed = !ser_ctx->write(
+            ser_ctx->user, ser_ctx->out, ser_ctx->pos
+        );
+    }
 
-static inline void json_stringy_kill(json_stringy_t *stringy) {
-    json_fat_free(stringy->str);
+    ser_ctx->pos = 0;
 }
 
-static void json_stringy_append(
-    json_stringy_t *stringy, const char *str, size_t len
+static void json_serialize_append(
+    json_serializer_t *ser_ctx, const char *str, size_t len
 ) {
-    if (stringy->pos + len >= stringy->cap) {
-        stringy->cap <<= 1;
-        stringy->str = (char *)json_fat_realloc(
-            stringy->str,
-            stringy->cap * sizeof(*stringy->str)
-        );
+    if (ser_ctx->pos + len > ser_ctx->cap) {
+        if (ser_ctx->write) {
+            json_serialize_flush(ser_ctx);
+
+            // too big to buffer, pass it straight through
+            if (len > ser_ctx->cap) {
+                if (!ser_ctx->failed)
+                    ser_ctx->failed = !ser_ctx->write(ser_ctx->user, str, len);
+
+                return;
+            }
+        } else if (ser_ctx->fixed) {
+            // out of room, fill what's left like snprintf and only count the
+            // rest of the output
+            if (!ser_ctx->truncated) {
+                if (ser_ctx->cap > ser_ctx->pos) {
+                    memcpy(
+                        ser_ctx->out + ser_ctx->pos, str,
+                        ser_ctx->cap - ser_ctx->pos
+                    );
+                }
+
+                ser_ctx->truncated = true;
+                ser_ctx->written = ser_ctx->cap;
+            }
+
+            ser_ctx->pos += len;
+
+            return;
+        } else {
+            while (ser_ctx->pos + len > ser_ctx->cap)
+                ser_ctx->cap <<= 1;
+
+            char *grown = (char *)JSON_MALLOC(ser_ctx->cap);
+
+            memcpy(grown, ser_ctx->out, ser_ctx->pos);
+            JSON_FREE(ser_ctx->out);
+
+            ser_ctx->out = grown;
+        }
     }
 
-    // extra parens here suppress an unnecessary gcc warning
-    (strncpy(stringy->str + stringy->pos, str, len));
+    memcpy(ser_ctx->out + ser_ctx->pos, str, len);
 
-    stringy->pos += len;
+    ser_ctx->pos += len;
 }
 
-static void json_serialize_string(json_serializer_t *ser_ctx, char *str) {
-    json_stringy_append(&ser_ctx->stringy, "\"", 1);
+static void json_serialize_string(
+    json_serializer_t *ser_ctx, const char *str, size_t len
+) {
+    const char *end = str + len;
+
+    json_serialize_append(ser_ctx, "\"", 1);
+
+    while (str < end) {
+        // append characters which don't need escaping in bulk
+        size_t run = json_string_run(str, end - str);
+
+        json_serialize_append(ser_ctx, str, run);
+        str += run;
+
+        if (str == end)
+            break;
 
-    while (*str) {
         switch (*str) {
 #define X(a, b)\
         case b:\
             sprintf(ser_ctx->buf, "\\%c", a);\
-            json_stringy_append(&ser_ctx->stringy, ser_ctx->buf, 2);\
+            json_serialize_append(ser_ctx, ser_ctx->buf, 2);\
             break;
 
         JSON_SERIALIZE_ESCAPE_CHARACTERS_X
 #undef X
         default:
-            json_stringy_append(&ser_ctx->stringy, str, 1);\
+            // other control characters (including decoded nulls)
+            sprintf(ser_ctx->buf, "\\u%04x", (unsigned char)*str);
+            json_serialize_append(ser_ctx, ser_ctx->buf, 6);
             break;
         }
 
         ++str;
     }
 
-    json_stringy_append(&ser_ctx->stringy, "\"", 1);
+    json_serialize_append(ser_ctx, "\"", 1);
+}
+
+// writes an integer's digits to buf, returns the number of chars written
+static size_t json_format_int64(char *buf, int64_t integer) {
+    char digits[20];
+    size_t num_digits = 0, len = 0;
+    uint64_t magnitude = integer < 0
+        ? (uint64_t)0 - (uint64_t)integer : (uint64_t)integer;
+
+    do {
+        digits[num_digits++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (integer < 0)
+        buf[len++] = '-';
+
+    while (num_digits)
+        buf[len++] = digits[--num_digits];
+
+    return len;
 }
 
 static inline void json_serialize_indent(json_serializer_t *ser_ctx) {
+    static const char spaces[] = "                                ";
+
     if (!ser_ctx->mini) {
-        int indent = ser_ctx->level * ser_ctx->indent;
+        size_t indent = (size_t)(ser_ctx->level * ser_ctx->indent);
 
-        sprintf(ser_ctx->buf, "%*s", indent, "");
-        json_stringy_append(&ser_ctx->stringy, ser_ctx->buf, indent);
+        for (; indent > sizeof(spaces) - 1; indent -= sizeof(spaces) - 1)
+            json_serialize_append(ser_ctx, spaces, sizeof(spaces) - 1);
+
+        json_serialize_append(ser_ctx, spaces, indent);
     }
 }
 
@@ -1217,6 +4809,8 @@ static void json_serialize_obj(json_serializer_t *, json_object_t *);
 static void json_serialize_value(
     json_serializer_t *ser_ctx, json_object_t *object
 ) {
+    json_expand(object);
+
     switch (object->type) {
     case JSON_OBJECT:
         json_serialize_obj(ser_ctx, object);
@@ -1227,32 +4821,51 @@ static void json_serialize_value(
 
         break;
     case JSON_STRING:
-        json_serialize_string(ser_ctx, object->data.string);
+        json_serialize_string(ser_ctx, object->data.string, object->length);
 
         break;
-    case JSON_NUMBER:
-        if ((long)object->data.number == object->data.number)
-            sprintf(ser_ctx->buf, "%ld", (long)object->data.number);
-        else
-            sprintf(ser_ctx->buf, "%lf", object->data.number);
+    case JSON_NUMBER: {
+        // the range check comes first, casting anything outside of it is
+        // undefined. -0 compares equal to 0, so its sign is checked as well
+        double number = object->data.number;
+
+        if (!signbit(number)
+         && number >= (double)INT64_MIN && number < -(double)INT64_MIN
+         && (int64_t)number == number) {
+            json_serialize_append(
+                ser_ctx,
+                ser_ctx->buf,
+                json_format_int64(ser_ctx->buf, (int64_t)number)
+            );
+        } else {
+            sprintf(ser_ctx->buf, "%lf", number);
+            json_serialize_append(
+                ser_ctx,
+                ser_ctx->buf,
+                strlen(ser_ctx->buf)
+            );
+        }
 
-        json_stringy_append(
-            &ser_ctx->stringy,
+        break;
+    }
+    case JSON_INTEGER:
+        json_serialize_append(
+            ser_ctx,
             ser_ctx->buf,
-            strlen(ser_ctx->buf)
+            json_format_int64(ser_ctx->buf, object->data.integer)
         );
 
         break;
     case JSON_TRUE:
-        json_stringy_append(&ser_ctx->stringy, "true", 4);
+        json_serialize_append(ser_ctx, "true", 4);
 
         break;
     case JSON_FALSE:
-        json_stringy_append(&ser_ctx->stringy, "false", 5);
+        json_serialize_append(ser_ctx, "false", 5);
 
         break;
     case JSON_NULL:
-        json_stringy_append(&ser_ctx->stringy, "null", 4);
+        json_serialize_append(ser_ctx, "null", 4);
 
         break;
     }
@@ -1261,13 +4874,13 @@ static void json_serialize_value(
 static void json_serialize_array(
     json_serializer_t *ser_ctx, json_object_t *object
 ) {
-    json_stringy_append(&ser_ctx->stringy, "[\n", ser_ctx->nlwidth);
+    json_serialize_append(ser_ctx, "[\n", ser_ctx->nlwidth);
 
     ++ser_ctx->level;
 
-    for (size_t i = 0; i < object->data.vec->size; ++i) {
+    for (size_t i = 0; i < object->data.vec->size && !ser_ctx->failed; ++i) {
         if (i)
-            json_stringy_append(&ser_ctx->stringy, ",\n", ser_ctx->nlwidth);
+            json_serialize_append(ser_ctx, ",\n", ser_ctx->nlwidth);
 
         json_serialize_indent(ser_ctx);
         json_serialize_value(
@@ -1277,82 +4890,177 @@ static void json_serialize_array(
     }
 
     if (!ser_ctx->mini)
-        json_stringy_append(&ser_ctx->stringy, "\n", 1);
+        json_serialize_append(ser_ctx, "\n", 1);
 
     --ser_ctx->level;
 
     json_serialize_indent(ser_ctx);
-    json_stringy_append(&ser_ctx->stringy, "]", 1);
+    json_serialize_append(ser_ctx, "]", 1);
 }
 
 static void json_serialize_obj(
     json_serializer_t *ser_ctx, json_object_t *object
 ) {
-    json_stringy_append(&ser_ctx->stringy, "{\n", ser_ctx->nlwidth);
+    json_serialize_append(ser_ctx, "{\n", ser_ctx->nlwidth);
 
     ++ser_ctx->level;
 
     json_hmap_t *hmap = object->data.hmap;
     json_vec_t *vec = &hmap->vec;
 
-    for (size_t i = 0; i < vec->size; ++i) {
+    for (size_t i = 0; i < vec->size && !ser_ctx->failed; ++i) {
         if (i) {
-            json_stringy_append(&ser_ctx->stringy, ",\n", ser_ctx->nlwidth);
+            json_serialize_append(ser_ctx, ",\n", ser_ctx->nlwidth);
         }
 
         json_serialize_indent(ser_ctx);
-        json_serialize_string(ser_ctx, (char *)vec->data[i]);
-        json_stringy_append(&ser_ctx->stringy, ": ", ser_ctx->nlwidth);
-
-        json_serialize_value(
+        json_serialize_string(
             ser_ctx,
-            json_hmap_get(hmap, (char *)vec->data[i])
+            (char *)vec->data[i],
+            hmap->entries[i].key_len
         );
+        json_serialize_append(ser_ctx, ": ", ser_ctx->nlwidth);
+
+        json_serialize_value(ser_ctx, hmap->entries[i].object);
     }
 
     if (!ser_ctx->mini)
-        json_stringy_append(&ser_ctx->stringy, "\n", 1);
+        json_serialize_append(ser_ctx, "\n", 1);
 
     --ser_ctx->level;
 
     json_serialize_indent(ser_ctx);
-    json_stringy_append(&ser_ctx->stringy, "}", 1);
+    json_serialize_append(ser_ctx, "}", 1);
 }
 
-char *json_serialize(
-    json_object_t *object, bool mini, int indent, size_t *out_len
+static void json_serializer_make(
+    json_serializer_t *ser_ctx, json_object_t *object, bool mini, int indent
 ) {
     if (!object)
         JSON_ERROR("attempted to serialize a NULL object.\n");
 
+    ser_ctx->level = 0;
+    ser_ctx->indent = indent;
+    ser_ctx->mini = mini;
+    ser_ctx->nlwidth = ser_ctx->mini ? 1 : 2;
+    ser_ctx->pos = 0;
+    ser_ctx->failed = ser_ctx->fixed = ser_ctx->truncated = false;
+}
+
+char *json_serialize(
+    json_object_t *object, bool mini, int indent, size_t *out_len
+) {
     // create and use serializer
     json_serializer_t ser_ctx;
 
-    json_stringy_make(&ser_ctx.stringy);
+    json_serializer_make(&ser_ctx, object, mini, indent);
+
+    ser_ctx.cap = JSON_SERIALIZE_INIT_CAP;
+    ser_ctx.out = (char *)JSON_MALLOC(ser_ctx.cap);
+    ser_ctx.write = NULL;
+
+    json_serialize_value(&ser_ctx, object);
+    json_serialize_append(&ser_ctx, "\n", 2);
+
+    // the output buffer is returned as is, the null terminator was appended
+    // with the newline
+    if (out_len)
+        *out_len = ser_ctx.pos;
+
+    return ser_ctx.out;
+}
+
+bool json_serialize_to(
+    json_object_t *object, const json_write_opts_t *opts, json_writer_fn write,
+    void *user
+) {
+    json_serializer_t ser_ctx;
+
+    json_serializer_make(
+        &ser_ctx, object, opts ? opts->mini : false, opts ? opts->indent : 2
+    );
+
+    char out[JSON_WRITE_BUF_SIZE];
 
-    ser_ctx.buf = (char *)JSON_MALLOC(JSON_SERIALIZER_BUF_SIZE);
-    ser_ctx.level = 0;
-    ser_ctx.indent = indent;
-    ser_ctx.mini = mini;
-    ser_ctx.nlwidth = ser_ctx.mini ? 1 : 2;
+    ser_ctx.out = out;
+    ser_ctx.cap = sizeof(out);
+    ser_ctx.write = write;
+    ser_ctx.user = user;
 
     json_serialize_value(&ser_ctx, object);
-    json_stringy_append(&ser_ctx.stringy, "\n", 2);
+    json_serialize_append(&ser_ctx, "\n", 1);
+    json_serialize_flush(&ser_ctx);
 
-    JSON_FREE(ser_ctx.buf);
+    return !ser_ctx.failed;
+}
 
-    // return serialized string
-    size_t len = ser_ctx.stringy.pos;
-    char *serialized = (char *)JSON_MALLOC((len + 1) * sizeof(*serialized));
+size_t json_serialize_into(
+    json_object_t *object, const json_write_opts_t *opts, char *buf, size_t cap
+) {
+    json_serializer_t ser_ctx;
 
-    if (out_len)
-        *out_len = len;
+    json_serializer_make(
+        &ser_ctx, object, opts ? opts->mini : false, opts ? opts->indent : 2
+    );
+
+    // leave room for the null terminator
+    ser_ctx.out = buf;
+    ser_ctx.cap = buf && cap ? cap - 1 : 0;
+    ser_ctx.write = NULL;
+    ser_ctx.fixed = true;
+
+    json_serialize_value(&ser_ctx, object);
+    json_serialize_append(&ser_ctx, "\n", 1);
+
+    if (buf && cap)
+        buf[ser_ctx.truncated ? ser_ctx.written : ser_ctx.pos] = '\0';
+
+    return ser_ctx.pos;
+}
+
+size_t json_serialized_size(
+    json_object_t *object, const json_write_opts_t *opts
+) {
+    return json_serialize_into(object, opts, NULL, 0);
+}
+
+static bool json_write_file(void *user, const char *data, size_t len) {
+    return fwrite(data, 1, len, (FILE *)user) == len;
+}
+
+bool json_serialize_file(
+    json_object_t *object, const json_write_opts_t *opts, FILE *file
+) {
+    return json_serialize_to(object, opts, json_write_file, file);
+}
+
+#ifdef JSON_FD
+static bool json_write_fd(void *user, const char *data, size_t len) {
+    int fd = *(int *)user;
+
+    while (len) {
+        long written = (long)JSON_FD_WRITE(fd, data, len);
 
-    strcpy(serialized, ser_ctx.stringy.str);
-    json_stringy_kill(&ser_ctx.stringy);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
 
-    return serialized;
+            return false;
+        }
+
+        data += written;
+        len -= (size_t)written;
+    }
+
+    return true;
+}
+
+bool json_serialize_fd(
+    json_object_t *object, const json_write_opts_t *opts, int fd
+) {
+    return json_serialize_to(object, opts, json_write_fd, &fd);
 }
+#endif
 
 // get/put/to api functions ====================================================
 
@@ -1364,7 +5072,14 @@ char *json_serialize(
     )
 
 static inline json_object_t *json_empty_object(json_t *json) {
-    return (json_object_t *)json_page_alloc(json, sizeof(json_object_t));
+    json_object_t *object = (json_object_t *)json_page_alloc(
+        json,
+        sizeof(json_object_t)
+    );
+
+    object->lazy = false;
+
+    return object;
 }
 
 json_object_t *json_get_object(json_object_t *object, char *key) {
@@ -1374,7 +5089,9 @@ json_object_t *json_get_object(json_object_t *object, char *key) {
         key
     );
 
-    return json_hmap_get(object->data.hmap, key);
+    json_expand(object);
+
+    return json_hmap_get(object->data.hmap, key, strlen(key));
 }
 
 json_object_t **json_get_array(
@@ -1387,15 +5104,27 @@ char *json_get_string(json_object_t *object, char *key) {
     return json_to_string(json_get_object(object, key));
 }
 
+char *json_get_string_len(
+    json_object_t *object, char *key, size_t *out_len
+) {
+    return json_to_string_len(json_get_object(object, key), out_len);
+}
+
 double json_get_number(json_object_t *object, char *key) {
     return json_to_number(json_get_object(object, key));
 }
 
+int64_t json_get_int64(json_object_t *object, char *key) {
+    return json_to_int64(json_get_object(object, key));
+}
+
 bool json_get_bool(json_object_t *object, char *key) {
     return json_to_bool(json_get_object(object, key));
 }
 
 char **json_get_keys(json_object_t *object, size_t *out_size) {
+    json_expand(object);
+
     json_hmap_t *hmap = object->data.hmap;
 
     if (out_size)
@@ -1407,6 +5136,8 @@ char **json_get_keys(json_object_t *object, size_t *out_size) {
 json_object_t **json_to_array(json_object_t *object, size_t *out_size) {
     JSON_ASSERT_PROPER_CAST(JSON_ARRAY);
 
+    json_expand(object);
+
     json_vec_t *vec = object->data.vec;
 
     if (out_size)
@@ -1421,12 +5152,51 @@ char *json_to_string(json_object_t *object) {
     return object->data.string;
 }
 
+char *json_to_string_len(json_object_t *object, size_t *out_len) {
+    JSON_ASSERT_PROPER_CAST(JSON_STRING);
+
+    if (out_len)
+        *out_len = object->length;
+
+    return object->data.string;
+}
+
 double json_to_number(json_object_t *object) {
-    JSON_ASSERT_PROPER_CAST(JSON_NUMBER);
+    JSON_ASSERT(
+        object->type == JSON_NUMBER || object->type == JSON_INTEGER,
+        "attempted to cast %s to number.\n",
+        json_types[object->type]
+    );
+
+    if (object->type == JSON_INTEGER)
+        return (double)object->data.integer;
 
     return object->data.number;
 }
 
+int64_t json_to_int64(json_object_t *object) {
+    JSON_ASSERT(
+        object->type == JSON_NUMBER || object->type == JSON_INTEGER,
+        "attempted to cast %s to int64.\n",
+        json_types[object->type]
+    );
+
+    if (object->type == JSON_INTEGER)
+        return object->data.integer;
+
+    // casting a double outside of int64_t's range is undefined, so clamp
+    double number = object->data.number;
+
+    if (number != number)
+        return 0;
+    else if (number >= -(double)INT64_MIN)
+        return INT64_MAX;
+    else if (number <= (double)INT64_MIN)
+        return INT64_MIN;
+
+    return (int64_t)number;
+}
+
 bool json_to_bool(json_object_t *object) {
     JSON_ASSERT(
         object->type == JSON_TRUE || object->type == JSON_FALSE,
@@ -1438,13 +5208,17 @@ bool json_to_bool(json_object_t *object) {
 }
 
 json_object_t *json_pop(json_t *json, json_object_t *object, char *key) {
-    return json_hmap_del(json, object->data.hmap, key, false);
+    json_expand(object);
+
+    return json_hmap_del(json, object->data.hmap, key, strlen(key), false);
 }
 
 json_object_t *json_pop_ordered(
     json_t *json, json_object_t *object, char *key
 ) {
-    return json_hmap_del(json, object->data.hmap, key, true);
+    json_expand(object);
+
+    return json_hmap_del(json, object->data.hmap, key, strlen(key), true);
 }
 
 json_object_t *json_new_object(json_t *json) {
@@ -1484,12 +5258,13 @@ json_object_t *json_new_string(json_t *json, char *string) {
     json_object_t *object = json_empty_object(json);
 
     object->type = JSON_STRING;
+    object->length = strlen(string);
     object->data.string = (char *)json_page_alloc(
         json,
-        (strlen(string) + 1) * sizeof(*string)
+        (object->length + 1) * sizeof(*string)
     );
 
-    strcpy(object->data.string, string);
+    memcpy(object->data.string, string, object->length + 1);
 
     return object;
 }
@@ -1503,6 +5278,15 @@ json_object_t *json_new_number(json_t *json, double number) {
     return object;
 }
 
+json_object_t *json_new_int64(json_t *json, int64_t integer) {
+    json_object_t *object = json_empty_object(json);
+
+    object->type = JSON_INTEGER;
+    object->data.integer = integer;
+
+    return object;
+}
+
 json_object_t *json_new_bool(json_t *json, bool value) {
     json_object_t *object = json_empty_object(json);
 
@@ -1522,30 +5306,42 @@ json_object_t *json_new_null(json_t *json) {
 json_object_t *json_copy(json_t *json, json_object_t *object) {
     json_object_t *copied = json_empty_object(json);
 
+    json_expand(object);
+
     copied->type = object->type;
 
     switch (copied->type) {
-    case JSON_OBJECT:
+    case JSON_OBJECT: {
         // init hmap
         copied->data.hmap = (json_hmap_t *)json_page_alloc(
             json,
             sizeof(*copied->data.hmap)
         );
 
-        json_hmap_make(json, copied->data.hmap, JSON_HMAP_INIT_CAP);
+        json_hmap_t *hmap = object->data.hmap;
 
-        // copy data
-        size_t num_keys;
-        char **keys = json_get_keys(object, &num_keys);
+        json_hmap_make(json, copied->data.hmap, hmap->vec.size);
 
-        for (size_t i = 0; i < num_keys; ++i) {
-            json_object_t *child = json_get_object(object, keys[i]);
+        // copy data. keys are copied too so the copy doesn't point into the
+        // source's pages
+        for (size_t i = 0; i < hmap->vec.size; ++i) {
+            size_t key_len = hmap->entries[i].key_len;
+            char *key = (char *)json_page_alloc(json, key_len + 1);
 
-            json_put(json, copied, keys[i], json_copy(json, child));
+            memcpy(key, hmap->vec.data[i], key_len + 1);
+
+            json_hmap_put(
+                json,
+                copied->data.hmap,
+                key,
+                key_len,
+                json_copy(json, hmap->entries[i].object)
+            );
         }
 
         break;
-    case JSON_ARRAY:
+    }
+    case JSON_ARRAY: {
         // init vec
         copied->data.vec = (json_vec_t *)json_page_alloc(
             json,
@@ -1562,19 +5358,21 @@ json_object_t *json_copy(json_t *json, json_object_t *object) {
             json_vec_push(json, copied->data.vec, json_copy(json, children[i]));
 
         break;
-    case JSON_STRING:;
+    }
+    case JSON_STRING: {
         // allocate new string and copy
         char *string = object->data.string;
 
+        copied->length = object->length;
         copied->data.string = (char *)json_page_alloc(
             json,
-            // TODO store string lengths for objects?
-            (strlen(string) + 1) * sizeof(*string)
+            (object->length + 1) * sizeof(*string)
         );
 
-        strcpy(copied->data.string, string);
+        memcpy(copied->data.string, string, object->length + 1);
 
         break;
+    }
     default:
         copied->data = object->data;
 
@@ -1592,13 +5390,15 @@ void json_put(
         "called put_object on a non-object.\n"
     );
 
-    json_hmap_put(json, object->data.hmap, key, child);
+    json_expand(object);
+
+    json_hmap_put(json, object->data.hmap, key, strlen(key), child);
 }
 
 void json_put_copy(
     json_t *json, json_object_t *object, char *key, json_object_t *child
 ) {
-    json_put(json, object, key, json_copy(child));
+    json_put(json, object, key, json_copy(json, child));
 }
 
 json_object_t *json_put_object(
@@ -1630,6 +5430,12 @@ void json_put_number(
     json_put(json, object, key, json_new_number(json, number));
 }
 
+void json_put_int64(
+    json_t *json, json_object_t *object, char *key, int64_t integer
+) {
+    json_put(json, object, key, json_new_int64(json, integer));
+}
+
 void json_put_bool(json_t *json, json_object_t *object, char *key, bool value) {
     json_put(json, object, key, json_new_bool(json, value));
 }
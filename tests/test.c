@@ -0,0 +1,1679 @@
+// tests for ghh_json.h. every entry point is checked against json_load() on the
+// same generated texts, by comparing a canonical dump of what each one parsed.
+// build and run from the repository root:
+//
+//     cc -std=c99 -Wall -Wextra -o json_test tests/test.c && ./json_test
+
+#define GHH_JSON_IMPL
+#include "../ghh_json.h"
+
+#include <math.h>
+#include <stdarg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TEST_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+static int failures = 0;
+
+#define CHECK(cond, ...)\
+    do {\
+        if (!(cond)) {\
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);\
+            fprintf(stderr, __VA_ARGS__);\
+            fputc('\n', stderr);\
+\
+            if (++failures >= 20)\
+                exit(1);\
+        }\
+    } while (0)
+
+// growable strings ============================================================
+
+typedef struct buf {
+    char *data;
+    size_t len, cap;
+} buf_t;
+
+static void buf_put(buf_t *buf, const char *data, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        buf->cap = buf->cap ? buf->cap : 256;
+
+        while (buf->len + len + 1 > buf->cap)
+            buf->cap <<= 1;
+
+        buf->data = (char *)realloc(buf->data, buf->cap);
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+static void buf_puts(buf_t *buf, const char *str) {
+    buf_put(buf, str, strlen(str));
+}
+
+static void buf_printf(buf_t *buf, const char *fmt, ...) {
+    char str[64];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(str, sizeof(str), fmt, args);
+    va_end(args);
+
+    buf_puts(buf, str);
+}
+
+static char *buf_take(buf_t *buf) {
+    char *data = buf->data ? buf->data : (char *)calloc(1, 1);
+
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+
+    return data;
+}
+
+// canonical dumps =============================================================
+// every value is followed by ',' and every key by ':', so that dumps built from
+// objects and from sax events match exactly
+
+static void dump_string(buf_t *buf, const char *str, size_t len) {
+    buf_put(buf, "\"", 1);
+
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char ch = (unsigned char)str[i];
+
+        if (ch >= 0x20 && ch < 0x7f && ch != '\"' && ch != '\\')
+            buf_put(buf, str + i, 1);
+        else
+            buf_printf(buf, "\\x%02x", ch);
+    }
+
+    buf_put(buf, "\"", 1);
+}
+
+static void dump_object(buf_t *buf, json_object_t *object) {
+    switch (object->type) {
+    case JSON_OBJECT: {
+        size_t size;
+        char **keys = json_get_keys(object, &size);
+
+        buf_puts(buf, "{");
+
+        for (size_t i = 0; i < size; ++i) {
+            dump_string(buf, keys[i], strlen(keys[i]));
+            buf_puts(buf, ":");
+            dump_object(buf, json_get_object(object, keys[i]));
+        }
+
+        buf_puts(buf, "},");
+
+        break;
+    }
+    case JSON_ARRAY: {
+        size_t size;
+        json_object_t **objects = json_to_array(object, &size);
+
+        buf_puts(buf, "[");
+
+        for (size_t i = 0; i < size; ++i)
+            dump_object(buf, objects[i]);
+
+        buf_puts(buf, "],");
+
+        break;
+    }
+    case JSON_STRING: {
+        size_t len;
+        char *str = json_to_string_len(object, &len);
+
+        dump_string(buf, str, len);
+        buf_puts(buf, ",");
+
+        break;
+    }
+    case JSON_NUMBER:
+        buf_printf(buf, "%.17g,", object->data.number);
+        break;
+    case JSON_INTEGER:
+        buf_printf(buf, "i%lld,", (long long)object->data.integer);
+        break;
+    case JSON_TRUE:
+        buf_puts(buf, "true,");
+        break;
+    case JSON_FALSE:
+        buf_puts(buf, "false,");
+        break;
+    case JSON_NULL:
+        buf_puts(buf, "null,");
+        break;
+    }
+}
+
+static char *dump_json(json_t *json) {
+    buf_t buf = {NULL, 0, 0};
+
+    if (json->root)
+        dump_object(&buf, json->root);
+    else
+        buf_puts(&buf, "empty");
+
+    return buf_take(&buf);
+}
+
+static bool sax_start_object(void *user) {
+    buf_puts((buf_t *)user, "{");
+    return true;
+}
+
+static bool sax_end_object(void *user) {
+    buf_puts((buf_t *)user, "},");
+    return true;
+}
+
+static bool sax_start_array(void *user) {
+    buf_puts((buf_t *)user, "[");
+    return true;
+}
+
+static bool sax_end_array(void *user) {
+    buf_puts((buf_t *)user, "],");
+    return true;
+}
+
+static bool sax_key(void *user, const char *key, size_t len) {
+    dump_string((buf_t *)user, key, len);
+    buf_puts((buf_t *)user, ":");
+    return true;
+}
+
+static bool sax_string(void *user, const char *str, size_t len) {
+    dump_string((buf_t *)user, str, len);
+    buf_puts((buf_t *)user, ",");
+    return true;
+}
+
+static bool sax_number(void *user, double number) {
+    buf_printf((buf_t *)user, "%.17g,", number);
+    return true;
+}
+
+static bool sax_integer(void *user, int64_t integer) {
+    buf_printf((buf_t *)user, "i%lld,", (long long)integer);
+    return true;
+}
+
+static bool sax_boolean(void *user, bool value) {
+    buf_puts((buf_t *)user, value ? "true," : "false,");
+    return true;
+}
+
+static bool sax_null(void *user) {
+    buf_puts((buf_t *)user, "null,");
+    return true;
+}
+
+static const json_sax_handler_t sax_dump_handler = {
+    sax_start_object, sax_end_object, sax_start_array, sax_end_array,
+    sax_key, sax_string, sax_number, sax_integer, sax_boolean, sax_null
+};
+
+// text generation =============================================================
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static size_t rng_below(size_t n) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+
+    return (size_t)((rng_state * 0x2545f4914f6cdd1d) >> 33) % n;
+}
+
+static void gen_whitespace(buf_t *buf) {
+    static const char whitespace[] = " \t\r\n";
+
+    if (rng_below(3))
+        return;
+
+    for (size_t n = 1 + rng_below(3); n; --n)
+        buf_put(buf, &whitespace[rng_below(4)], 1);
+}
+
+static void gen_string(buf_t *buf) {
+    static const char *pieces[] = {
+        "a", "b", "xyz", " ", "\\n", "\\\"", "\\\\", "\\/", "\\t", "\\r",
+        "\\b", "\\f", "\xc3\xa9", "{", "]", ",", ":", "\\u00e9", "\\u001F",
+        "\\u20aC", "\\ud83d\\ude00", "\\u0000"
+    };
+    // long runs of plain characters go through the bulk copies
+    size_t n = rng_below(4) ? rng_below(8) : rng_below(100);
+
+    buf_puts(buf, "\"");
+
+    for (size_t i = 0; i < n; ++i)
+        buf_puts(buf, pieces[rng_below(sizeof(pieces) / sizeof(*pieces))]);
+
+    buf_puts(buf, "\"");
+}
+
+static void gen_number(buf_t *buf) {
+    static const char *numbers[] = {
+        "0", "-0", "7", "-42", "123456789", "9223372036854775807",
+        "-9223372036854775808", "9223372036854775808", "-9223372036854775809",
+        "18446744073709551616", "0.5", "-12.25", "1e5", "-2.5E-3", "1E+2",
+        "0.1", "3.14159265358979323846", "1e308", "1e400", "-0.0", "5e-324",
+        "123456789012345678901234567890",
+        // longer than json_strtod()'s stack buffer
+        "0.00000000000000000000000000000000000000000000000000000000000000001"
+        "234567890123456789",
+    };
+
+    buf_puts(buf, numbers[rng_below(sizeof(numbers) / sizeof(*numbers))]);
+}
+
+static void gen_value(buf_t *buf, int depth) {
+    size_t kind = rng_below(depth > 4 ? 6 : 8);
+
+    gen_whitespace(buf);
+
+    switch (kind) {
+    case 0: gen_string(buf); break;
+    case 1:
+    case 2: gen_number(buf); break;
+    case 3: buf_puts(buf, "true"); break;
+    case 4: buf_puts(buf, "false"); break;
+    case 5: buf_puts(buf, "null"); break;
+    case 6: {
+        size_t n = rng_below(6);
+
+        buf_puts(buf, "{");
+        gen_whitespace(buf);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (i)
+                buf_puts(buf, ",");
+
+            gen_whitespace(buf);
+            buf_printf(buf, "\"k%zu\"", i);
+            gen_whitespace(buf);
+            buf_puts(buf, ":");
+            gen_value(buf, depth + 1);
+        }
+
+        buf_puts(buf, "}");
+        break;
+    }
+    case 7: {
+        size_t n = rng_below(6);
+
+        buf_puts(buf, "[");
+        gen_whitespace(buf);
+
+        for (size_t i = 0; i < n; ++i) {
+            if (i)
+                buf_puts(buf, ",");
+
+            gen_value(buf, depth + 1);
+        }
+
+        buf_puts(buf, "]");
+        break;
+    }
+    }
+
+    gen_whitespace(buf);
+}
+
+// a random text with an object or array root
+static char *gen_doc(size_t *out_len) {
+    buf_t buf = {NULL, 0, 0};
+
+    do {
+        buf.len = 0;
+        gen_value(&buf, 0);
+    } while (buf.data[strspn(buf.data, " \t\r\n")] != '{'
+          && buf.data[strspn(buf.data, " \t\r\n")] != '[');
+
+    *out_len = buf.len;
+
+    return buf_take(&buf);
+}
+
+// an array root of exactly len bytes, for texts on either side of the
+// structural index's thresholds
+static char *gen_sized_doc(size_t len) {
+    buf_t buf = {NULL, 0, 0}, value = {NULL, 0, 0};
+
+    buf_puts(&buf, "[");
+
+    for (int misses = 0; misses < 8;) {
+        value.len = 0;
+        gen_value(&value, 2);
+
+        // + 2 leaves room for a comma and the closing bracket
+        if (buf.len + value.len + 2 > len) {
+            ++misses;
+            continue;
+        }
+
+        if (buf.len > 1)
+            buf_puts(&buf, ",");
+
+        buf_put(&buf, value.data, value.len);
+    }
+
+    while (buf.len + 1 < len)
+        buf_puts(&buf, buf.len % 7 ? " " : "\n");
+
+    buf_puts(&buf, "]");
+    free(value.data);
+
+    return buf_take(&buf);
+}
+
+// differential tests ==========================================================
+
+#define SPLIT_ALL_MAX 5000
+
+static json_t reused;
+
+// json_copy into another json_t, which has to stand on its own once the one
+// it was copied from is unloaded
+static void check_copy(json_t *json, const char *expect, const char *what) {
+    json_t copied;
+
+    json_load_empty(&copied);
+
+    if (json->root)
+        copied.root = json_copy(&copied, json->root);
+
+    json_unload(json);
+
+    char *dump = dump_json(&copied);
+
+    CHECK(!strcmp(dump, expect), "json_copy differs after %s", what);
+    free(dump);
+    json_unload(&copied);
+}
+
+// the same edits on a fully parsed and a lazily loaded document. the children
+// are edited before anything expands them, so on the lazy side every json_put
+// and json_pop lands on a lazy object
+static void edit_doc(json_t *json) {
+    static char added[] = "added", text[] = "text", first[] = "a";
+    static char copied[] = "copied";
+    json_object_t *root = json->root;
+    json_object_t **children = NULL;
+    json_object_t *array = NULL;
+    size_t size = 0;
+
+    if (!root)
+        return;
+
+    char **keys = NULL;
+    json_object_t **objects = NULL;
+
+    if (root->type == JSON_OBJECT)
+        keys = json_get_keys(root, &size);
+    else
+        objects = json_to_array(root, &size);
+
+    children = (json_object_t **)malloc((size + 1) * sizeof(*children));
+
+    for (size_t i = 0; i < size; ++i)
+        children[i] = keys ? json_get_object(root, keys[i]) : objects[i];
+
+    for (size_t i = 0; i < size; ++i) {
+        json_object_t *child = children[i];
+
+        if (child->type == JSON_ARRAY && !array)
+            array = child;
+
+        if (child->type != JSON_OBJECT)
+            continue;
+
+        switch (i % 3) {
+        case 0:
+            json_pop(json, child, first);
+            json_put_int64(json, child, added, (int64_t)i);
+            break;
+        case 1:
+            json_put_string(json, child, text, text);
+            break;
+        case 2:
+            json_put_copy(json, child, copied, child);
+            break;
+        }
+    }
+
+    if (root->type == JSON_OBJECT) {
+        if (array)
+            json_put_copy(json, root, copied, array);
+
+        json_pop_ordered(json, root, first);
+        json_put_null(json, root, added);
+    }
+
+    free(children);
+}
+
+// text[len] has to be a null terminator, like json_load_lazy() needs
+static void check_lazy_edits(const char *text, size_t len) {
+    json_t eager, lazy;
+
+    json_load_n(&eager, text, len);
+    json_load_lazy(&lazy, text, len);
+    edit_doc(&eager);
+    edit_doc(&lazy);
+
+    char *expect = dump_json(&eager);
+    char *dump = dump_json(&lazy);
+
+    CHECK(
+        !strcmp(dump, expect),
+        "edits on json_load_lazy differ on %zu bytes", len
+    );
+    free(dump);
+    json_unload(&lazy);
+
+    // and copying a lazy document before anything expands it
+    json_load_lazy(&lazy, text, len);
+    json_unload(&eager);
+    json_load_n(&eager, text, len);
+    dump = dump_json(&eager);
+    check_copy(&lazy, dump, "json_load_lazy");
+    free(dump);
+    free(expect);
+    json_unload(&eager);
+}
+
+static bool collect_writer(void *user, const char *data, size_t len) {
+    buf_put((buf_t *)user, data, len);
+    return true;
+}
+
+static bool failing_writer(void *user, const char *data, size_t len) {
+    (void)data;
+    (void)len;
+    ++*(size_t *)user;
+    return false;
+}
+
+// reads back everything written to a temporary file
+static char *read_back(FILE *file, size_t *out_len) {
+    buf_t buf = {NULL, 0, 0};
+    char chunk[4096];
+    size_t got;
+
+    rewind(file);
+
+    while ((got = fread(chunk, 1, sizeof(chunk), file)))
+        buf_put(&buf, chunk, got);
+
+    *out_len = buf.len;
+
+    return buf_take(&buf);
+}
+
+// every streaming serializer has to produce exactly what json_serialize does
+static void check_serialize(json_object_t *root) {
+    static const json_write_opts_t styles[] = {
+        {false, 2}, {true, 0}, {false, 4}
+    };
+
+    for (size_t i = 0; i < sizeof(styles) / sizeof(*styles); ++i) {
+        const json_write_opts_t *opts = &styles[i];
+        char *expect = json_serialize(root, opts->mini, opts->indent, NULL);
+        size_t len = strlen(expect), got_len;
+        char *got;
+
+        buf_t collected = {NULL, 0, 0};
+
+        CHECK(
+            json_serialize_to(root, opts, collect_writer, &collected)
+         && collected.len == len && !memcmp(collected.data, expect, len),
+            "json_serialize_to differs in style %zu", i
+        );
+        free(collected.data);
+
+        size_t calls = 0;
+
+        CHECK(
+            !json_serialize_to(root, opts, failing_writer, &calls)
+         && calls == 1,
+            "json_serialize_to kept writing after a failed write"
+        );
+
+        FILE *file = tmpfile();
+
+        CHECK(file, "couldn't open a temporary file");
+        CHECK(
+            json_serialize_file(root, opts, file),
+            "json_serialize_file failed"
+        );
+        got = read_back(file, &got_len);
+        CHECK(
+            got_len == len && !memcmp(got, expect, len),
+            "json_serialize_file differs in style %zu", i
+        );
+        free(got);
+        fclose(file);
+
+#ifdef TEST_POSIX
+        int fd = open(
+            "ghh_json_test.out", O_WRONLY | O_CREAT | O_TRUNC, 0644
+        );
+
+        CHECK(fd >= 0, "couldn't open ghh_json_test.out");
+        CHECK(json_serialize_fd(root, opts, fd), "json_serialize_fd failed");
+        close(fd);
+
+        file = fopen("ghh_json_test.out", "rb");
+        got = read_back(file, &got_len);
+        CHECK(
+            got_len == len && !memcmp(got, expect, len),
+            "json_serialize_fd differs in style %zu", i
+        );
+        free(got);
+        fclose(file);
+        remove("ghh_json_test.out");
+#endif
+
+        // sized exactly, then cut off at every interesting cap. a guard byte
+        // past cap has to stay untouched
+        CHECK(
+            json_serialized_size(root, opts) == len,
+            "json_serialized_size is wrong in style %zu", i
+        );
+
+        size_t caps[] = {0, 1, 2, len / 2, len, len + 1, len + 2};
+        char *into = (char *)malloc(len + 3);
+
+        for (size_t j = 0; j < sizeof(caps) / sizeof(*caps); ++j) {
+            size_t cap = caps[j];
+            size_t kept = cap ? (cap - 1 < len ? cap - 1 : len) : 0;
+
+            memset(into, '#', len + 3);
+
+            CHECK(
+                json_serialize_into(root, opts, into, cap) == len
+             && !memcmp(into, expect, kept)
+             && (!cap || into[kept] == '\0')
+             && into[cap] == '#',
+                "json_serialize_into is wrong with cap %zu of %zu", cap, len
+            );
+        }
+
+        free(into);
+        free(expect);
+    }
+}
+
+static void check_doc(const char *text, size_t len, const char *expect) {
+    json_t json;
+    json_error_t error;
+    // exact copies with no null terminator, so reads past len are caught by
+    // sanitizers
+    char *exact = (char *)malloc(len ? len : 1);
+    char *copy = (char *)malloc(len + 1);
+    char *dump;
+
+    memcpy(exact, text, len);
+
+    memcpy(copy, text, len + 1);
+    json_load_insitu(&json, copy);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_insitu differs on %zu bytes", len);
+    free(dump);
+    json_unload(&json);
+
+    json_load_n(&json, exact, len);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_n differs on %zu bytes", len);
+    free(dump);
+    check_serialize(json.root);
+    check_copy(&json, expect, "json_load_n");
+
+    json_reload_n(&reused, exact, len);
+    dump = dump_json(&reused);
+    CHECK(!strcmp(dump, expect), "json_reload_n differs on %zu bytes", len);
+    free(dump);
+
+    memcpy(copy, text, len + 1);
+    json_load_lazy(&json, copy, len);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_lazy differs on %zu bytes", len);
+    free(dump);
+    json_unload(&json);
+    check_lazy_edits(copy, len);
+
+    CHECK(
+        json_validate(exact, len, &error),
+        "json_validate rejects %zu bytes: %s", len, error.message
+    );
+
+    buf_t sax = {NULL, 0, 0};
+
+    CHECK(
+        json_sax_parse(text, len, &sax_dump_handler, &sax)
+        && !strcmp(sax.data, expect),
+        "json_sax_parse differs on %zu bytes", len
+    );
+    free(sax.data);
+
+    // fed in two chunks split at every offset, in three for large texts
+    size_t step = len <= SPLIT_ALL_MAX ? 1 : 509;
+
+    for (size_t split = 0; split <= len; split += step) {
+        json_parser_t parser;
+        size_t second = split + (len - split) / 2;
+
+        json_parser_init(&parser, &json);
+        json_feed(&parser, exact, split);
+
+        if (step > 1)
+            json_feed(&parser, exact + split, second - split);
+        else
+            second = split;
+
+        json_feed(&parser, exact + second, len - second);
+        json_finish(&parser);
+
+        dump = dump_json(&json);
+        CHECK(
+            !strcmp(dump, expect),
+            "json_feed differs on %zu bytes split at %zu", len, split
+        );
+        free(dump);
+        json_unload(&json);
+    }
+
+    // and a byte at a time
+    if (len <= 512) {
+        json_parser_t parser;
+
+        json_parser_init(&parser, &json);
+
+        for (size_t i = 0; i < len; ++i)
+            json_feed(&parser, exact + i, 1);
+
+        json_finish(&parser);
+
+        dump = dump_json(&json);
+        CHECK(!strcmp(dump, expect), "json_feed differs bytewise");
+        free(dump);
+        json_unload(&json);
+    }
+
+    // abandoned half way through, which leaks unless json_parser_free
+    // releases everything
+    {
+        json_parser_t parser;
+
+        json_parser_init(&parser, &json);
+        json_feed(&parser, exact, len / 2);
+        json_parser_free(&parser);
+        json_unload(&json);
+    }
+
+    free(exact);
+    free(copy);
+}
+
+// the parsed dump of text from json_load, which every other entry point has to
+// match
+static char *reference_dump(const char *text, size_t len) {
+    json_t json;
+    char *copy = (char *)malloc(len + 1);
+
+    memcpy(copy, text, len + 1);
+    json_load(&json, copy);
+
+    char *dump = dump_json(&json);
+
+    json_unload(&json);
+    free(copy);
+
+    return dump;
+}
+
+static void write_file(const char *path, const char *data, size_t len) {
+    FILE *file = fopen(path, "wb");
+
+    CHECK(file, "couldn't write %s", path);
+    fwrite(data, 1, len, file);
+    fclose(file);
+}
+
+// json lines, array streams and the file loaders on a batch of texts. raw
+// newlines only ever appear as whitespace, so they're swapped for spaces to
+// keep each text on one line
+static void check_batch(char **texts, char **expects, size_t n) {
+    buf_t lines = {NULL, 0, 0}, array = {NULL, 0, 0};
+
+    buf_puts(&array, "[");
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t start = lines.len;
+
+        buf_puts(&lines, texts[i]);
+
+        for (size_t j = start; j < lines.len; ++j)
+            if (lines.data[j] == '\n')
+                lines.data[j] = ' ';
+
+        buf_puts(&lines, i % 3 ? "\n" : "\n \n");
+
+        if (i)
+            buf_puts(&array, ",");
+
+        buf_puts(&array, texts[i]);
+    }
+
+    buf_puts(&array, "]");
+
+    // json lines, from a buffer and from a file
+    write_file("ghh_json_test.ndjson", lines.data, lines.len);
+
+    for (int from_file = 0; from_file < 2; ++from_file) {
+        json_lines_t reader;
+        json_t json;
+        size_t count = 0;
+
+        if (from_file)
+            json_lines_open(&reader, "ghh_json_test.ndjson");
+        else
+            json_lines_open_buffer(&reader, lines.data, lines.len);
+
+        json_load_empty(&json);
+
+        json_lines_status_e status;
+
+        while ((status = json_lines_next(&reader, &json)) != JSON_LINES_END) {
+            CHECK(
+                status == JSON_LINES_OK,
+                "json_lines_next failed on line %zu: %s",
+                reader.line, reader.error.message
+            );
+
+            if (status != JSON_LINES_OK || count == n)
+                break;
+
+            char *dump = dump_json(&json);
+
+            CHECK(
+                !strcmp(dump, expects[count]),
+                "json_lines_next differs on record %zu", count
+            );
+            free(dump);
+            ++count;
+        }
+
+        CHECK(count == n, "json lines read %zu of %zu records", count, n);
+
+        json_unload(&json);
+        json_lines_close(&reader);
+    }
+
+    // array streams
+    write_file("ghh_json_test.json", array.data, array.len);
+
+    json_array_stream_t stream;
+    json_t json;
+    size_t count = 0;
+
+    json_load_empty(&json);
+    json_array_stream_open(&stream, "ghh_json_test.json");
+
+    while (json_array_stream_next(&stream, &json)) {
+        char *dump = dump_json(&json);
+
+        CHECK(
+            count < n && !strcmp(dump, expects[count]),
+            "json_array_stream_next differs on element %zu", count
+        );
+        free(dump);
+        ++count;
+    }
+
+    CHECK(count == n, "array stream read %zu of %zu elements", count, n);
+
+    json_array_stream_close(&stream);
+    json_unload(&json);
+
+    // the whole array through json_load_file, and each text through
+    // json_load_files
+    buf_t expect = {NULL, 0, 0};
+
+    buf_puts(&expect, "[");
+
+    for (size_t i = 0; i < n; ++i)
+        buf_puts(&expect, expects[i]);
+
+    buf_puts(&expect, "],");
+
+    json_load_file(&json, "ghh_json_test.json");
+
+    char *dump = dump_json(&json);
+
+    CHECK(!strcmp(dump, expect.data), "json_load_file differs");
+    free(dump);
+    json_unload(&json);
+
+    size_t files = n < 8 ? n : 8;
+    const char *paths[10];
+    char names[8][32];
+    json_t out[10];
+    json_error_t errors[10];
+    json_load_opts_t opts = {0, errors, 0, NULL};
+
+    for (size_t i = 0; i < files; ++i) {
+        snprintf(names[i], sizeof(names[i]), "ghh_json_test_%zu.json", i);
+        write_file(names[i], texts[i], strlen(texts[i]));
+        paths[i] = names[i];
+    }
+
+    CHECK(
+        json_load_files(paths, files, out, &opts) == 0,
+        "json_load_files failed"
+    );
+
+    for (size_t i = 0; i < files; ++i) {
+        dump = dump_json(&out[i]);
+        CHECK(!strcmp(dump, expects[i]), "json_load_files differs on %zu", i);
+        free(dump);
+        json_unload(&out[i]);
+    }
+
+    // json_async_load on the same files, with a missing and an invalid file
+    // after them which have to fail without exiting
+    write_file("ghh_json_test_invalid.json", "[1,]", 4);
+    paths[files] = "ghh_json_test_missing.json";
+    paths[files + 1] = "ghh_json_test_invalid.json";
+    opts.queue_depth = 3;
+
+    CHECK(
+        json_async_load(paths, files + 2, out, &opts) == 2,
+        "json_async_load didn't fail on exactly 2 files"
+    );
+
+    for (size_t i = 0; i < files + 2; ++i) {
+        if (i < files) {
+            dump = dump_json(&out[i]);
+            CHECK(
+                !errors[i].message[0] && !strcmp(dump, expects[i]),
+                "json_async_load differs on %zu", i
+            );
+            free(dump);
+        } else {
+            CHECK(
+                errors[i].message[0] && !out[i].root,
+                "json_async_load didn't fail on %s", paths[i]
+            );
+        }
+
+        json_unload(&out[i]);
+    }
+
+    for (size_t i = 0; i < files; ++i)
+        remove(names[i]);
+
+    remove("ghh_json_test_invalid.json");
+    remove("ghh_json_test.ndjson");
+    remove("ghh_json_test.json");
+    free(lines.data);
+    free(array.data);
+    free(expect.data);
+}
+
+// errors which are caught have to match between json_validate and the json
+// lines reader, which parses like json_load_n
+static void check_invalid(const char *text, size_t len) {
+    static const char inserts[] = "{}[],:\"\\ a0-.e\t";
+    char *mutated = (char *)malloc(len + 2);
+    size_t at = rng_below(len + 1), n = len;
+
+    memcpy(mutated, text, len);
+
+    for (size_t i = 0; i < n; ++i)
+        if (mutated[i] == '\n')
+            mutated[i] = ' ';
+
+    switch (rng_below(4)) {
+    case 0: // delete a byte
+        if (at < n) {
+            memmove(mutated + at, mutated + at + 1, n - at - 1);
+            --n;
+        }
+
+        break;
+    case 1: // replace a byte
+        if (at < n)
+            mutated[at] = inserts[rng_below(sizeof(inserts) - 1)];
+
+        break;
+    case 2: // insert a byte
+        memmove(mutated + at + 1, mutated + at, n - at);
+        mutated[at] = inserts[rng_below(sizeof(inserts) - 1)];
+        ++n;
+
+        break;
+    case 3: // insert a null byte
+        memmove(mutated + at + 1, mutated + at, n - at);
+        mutated[at] = '\0';
+        ++n;
+
+        break;
+    }
+
+    size_t blank = 0, end = n;
+
+    while (blank < n && (mutated[blank] == ' ' || mutated[blank] == '\t'))
+        ++blank;
+
+    while (end > blank && (mutated[end - 1] == ' ' || mutated[end - 1] == '\t'))
+        --end;
+
+    // blank lines are skipped by the lines reader
+    if (blank < n) {
+        json_error_t error;
+        json_lines_t reader;
+        json_t json;
+
+        bool valid = json_validate(mutated, n, &error);
+
+        json_load_empty(&json);
+        json_lines_open_buffer(&reader, mutated, n);
+
+        json_lines_status_e status = json_lines_next(&reader, &json);
+
+        CHECK(
+            valid == (status == JSON_LINES_OK),
+            "json_validate says %d, json lines says %d", valid, status
+        );
+
+        // without a closing bracket at the end json_validate reports that
+        // rather than parsing a copy, so only then can the errors differ
+        bool bracket = mutated[end - 1] == '}' || mutated[end - 1] == ']';
+
+        if (!valid && status == JSON_LINES_ERROR && bracket) {
+            CHECK(
+                !strcmp(error.message, reader.error.message)
+                && error.column == reader.error.column,
+                "json_validate error \"%s\" at %zu, json lines error "
+                "\"%s\" at %zu",
+                error.message, error.column,
+                reader.error.message, reader.error.column
+            );
+        }
+
+        json_unload(&json);
+    }
+
+    free(mutated);
+}
+
+static void test_differential(void) {
+    static const size_t sizes[] = {
+        4095, 4096, 4097, 65535, 65536, 65537, 200000
+    };
+    enum { RANDOM_DOCS = 300, SIZED_DOCS = sizeof(sizes) / sizeof(*sizes) };
+    char *texts[RANDOM_DOCS + SIZED_DOCS];
+    char *expects[RANDOM_DOCS + SIZED_DOCS];
+    size_t n = 0;
+
+    json_load_empty(&reused);
+
+    for (size_t i = 0; i < RANDOM_DOCS; ++i, ++n) {
+        size_t len;
+
+        texts[n] = gen_doc(&len);
+        expects[n] = reference_dump(texts[n], len);
+        check_doc(texts[n], len, expects[n]);
+
+        for (int j = 0; j < 3; ++j)
+            check_invalid(texts[n], len);
+    }
+
+    for (size_t i = 0; i < SIZED_DOCS; ++i, ++n) {
+        texts[n] = gen_sized_doc(sizes[i]);
+        expects[n] = reference_dump(texts[n], sizes[i]);
+        check_doc(texts[n], sizes[i], expects[n]);
+    }
+
+    check_batch(texts, expects, n);
+
+    for (size_t i = 0; i < n; ++i) {
+        free(texts[i]);
+        free(expects[i]);
+    }
+
+    json_unload(&reused);
+}
+
+// allocations =================================================================
+
+static size_t allocs = 0, frees = 0;
+
+// blocks are offset from what malloc returns, so memory which is freed through
+// the wrong allocator crashes rather than going unnoticed
+#define COUNT_OFFSET 16
+
+static void *count_alloc(void *user, size_t size) {
+    (void)user;
+    ++allocs;
+
+    return (char *)malloc(size + COUNT_OFFSET) + COUNT_OFFSET;
+}
+
+static void count_free(void *user, void *ptr) {
+    (void)user;
+    ++frees;
+
+    free((char *)ptr - COUNT_OFFSET);
+}
+
+// once warm, reparsing into a json_t allocates nothing, whether the text is
+// indexed or not
+static void test_steady_state(void) {
+    json_allocator_t allocator = {count_alloc, count_free, NULL, NULL};
+    json_arena_opts_t opts = {0, 0, &allocator};
+    char *texts[2] = {gen_sized_doc(600), gen_sized_doc(20000)};
+    json_t json;
+
+    json_load_empty_ex(&json, &opts);
+
+    for (int i = 0; i < 2; ++i) {
+        size_t len = strlen(texts[i]);
+
+        // newlines are only whitespace, and would split json lines records
+        for (size_t j = 0; j < len; ++j)
+            if (texts[i][j] == '\n')
+                texts[i][j] = ' ';
+
+        for (int j = 0; j < 3; ++j)
+            json_reload_n(&json, texts[i], len);
+
+        size_t before = allocs;
+
+        for (int j = 0; j < 50; ++j)
+            json_reload_n(&json, texts[i], len);
+
+        CHECK(
+            allocs == before,
+            "%zu allocations reloading %zu bytes", allocs - before, len
+        );
+    }
+
+    // records of a json lines text, and elements of an array stream
+    buf_t lines = {NULL, 0, 0}, array = {NULL, 0, 0};
+
+    buf_puts(&array, "[");
+
+    for (int i = 0; i < 40; ++i) {
+        buf_puts(&lines, texts[i % 2]);
+        buf_puts(&lines, "\n");
+        buf_puts(&array, i ? "," : "");
+        buf_puts(&array, texts[i % 2]);
+    }
+
+    buf_puts(&array, "]");
+
+    json_lines_t reader;
+    size_t count = 0, before = 0;
+
+    json_lines_open_buffer(&reader, lines.data, lines.len);
+
+    while (json_lines_next(&reader, &json) == JSON_LINES_OK)
+        if (++count == 4)
+            before = allocs;
+
+    CHECK(count == 40, "json lines read %zu of 40 records", count);
+    CHECK(
+        allocs == before,
+        "%zu allocations reading json lines", allocs - before
+    );
+    json_lines_close(&reader);
+
+    json_array_stream_t stream;
+
+    write_file("ghh_json_test.json", array.data, array.len);
+    json_array_stream_open(&stream, "ghh_json_test.json");
+    count = 0;
+
+    while (json_array_stream_next(&stream, &json))
+        if (++count == 4)
+            before = allocs;
+
+    CHECK(count == 40, "array stream read %zu of 40 elements", count);
+    CHECK(
+        allocs == before,
+        "%zu allocations streaming an array", allocs - before
+    );
+    json_array_stream_close(&stream);
+    remove("ghh_json_test.json");
+
+    json_unload(&json);
+
+    CHECK(allocs > 0, "the json_t's allocator was never used");
+    CHECK(allocs == frees, "%zu allocations, %zu frees", allocs, frees);
+
+    free(texts[0]);
+    free(texts[1]);
+    free(lines.data);
+    free(array.data);
+}
+
+static void check_counted(size_t before, const char *what) {
+    CHECK(allocs > before, "%s didn't use the given allocator", what);
+    CHECK(
+        allocs == frees, "%zu allocations, %zu frees after %s",
+        allocs, frees, what
+    );
+}
+
+// every _ex loader and the incremental parser keep the allocator they're given
+static void test_allocator_ex(void) {
+    json_allocator_t allocator = {count_alloc, count_free, NULL, NULL};
+    json_arena_opts_t opts = {0, 0, &allocator};
+    char *text = gen_sized_doc(20000);
+    size_t len = strlen(text);
+    char *copy = (char *)malloc(len + 1);
+    json_t json;
+    size_t before;
+    char *dump;
+
+    json_load_n(&json, text, len);
+    char *expect = dump_json(&json);
+    json_unload(&json);
+
+    before = allocs;
+    json_load_ex(&json, strcpy(copy, text), &opts);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_ex differs");
+    free(dump);
+    json_unload(&json);
+    check_counted(before, "json_load_ex");
+
+    before = allocs;
+    json_load_insitu_ex(&json, strcpy(copy, text), &opts);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_insitu_ex differs");
+    free(dump);
+    json_unload(&json);
+    check_counted(before, "json_load_insitu_ex");
+
+    before = allocs;
+    json_load_n_ex(&json, text, len, &opts);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_n_ex differs");
+    free(dump);
+    json_unload(&json);
+    check_counted(before, "json_load_n_ex");
+
+    before = allocs;
+    json_load_lazy_ex(&json, text, len, &opts);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_lazy_ex differs");
+    free(dump);
+    json_unload(&json);
+    check_counted(before, "json_load_lazy_ex");
+
+    write_file("ghh_json_test.json", text, len);
+
+    before = allocs;
+    json_load_file_ex(&json, "ghh_json_test.json", &opts);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_load_file_ex differs");
+    free(dump);
+    json_unload(&json);
+    check_counted(before, "json_load_file_ex");
+
+    const char *paths[2] = {"ghh_json_test.json", "ghh_json_test.json"};
+    json_t out[2];
+    json_load_opts_t load_opts = {1, NULL, 0, &opts};
+
+    for (int async = 0; async < 2; ++async) {
+        const char *what = async ? "json_async_load" : "json_load_files";
+
+        before = allocs;
+
+        if (async)
+            json_async_load(paths, 2, out, &load_opts);
+        else
+            json_load_files(paths, 2, out, &load_opts);
+
+        for (int i = 0; i < 2; ++i) {
+            dump = dump_json(&out[i]);
+            CHECK(!strcmp(dump, expect), "%s differs on %d", what, i);
+            free(dump);
+            json_unload(&out[i]);
+        }
+
+        check_counted(before, what);
+    }
+
+    remove("ghh_json_test.json");
+
+    // fed in small chunks so tokens are carried across them
+    json_parser_t parser;
+
+    before = allocs;
+    json_parser_init_ex(&parser, &json, &opts);
+
+    for (size_t i = 0; i < len; i += 97)
+        json_feed(&parser, text + i, len - i < 97 ? len - i : 97);
+
+    json_finish(&parser);
+    dump = dump_json(&json);
+    CHECK(!strcmp(dump, expect), "json_parser_init_ex differs");
+    free(dump);
+    json_unload(&json);
+    check_counted(before, "json_feed");
+
+    // and given up on part of the way through
+    before = allocs;
+    json_parser_init_ex(&parser, &json, &opts);
+
+    for (size_t i = 0; i < len / 2; i += 97)
+        json_feed(&parser, text + i, 97);
+
+    json_parser_free(&parser);
+    json_unload(&json);
+    check_counted(before, "json_parser_free");
+
+    free(expect);
+    free(copy);
+    free(text);
+}
+
+// regressions =================================================================
+
+static void test_numbers(void) {
+    char text[] = "[-0, 1e300, -1e300, 9223372036854775808, 12.9, -12.9]";
+    json_t json;
+    size_t size;
+
+    json_load(&json, text);
+
+    json_object_t **objects = json_to_array(json.root, &size);
+
+    CHECK(
+        objects[0]->type == JSON_NUMBER && signbit(objects[0]->data.number),
+        "-0 lost its sign"
+    );
+    CHECK(json_to_int64(objects[1]) == INT64_MAX, "1e300 isn't clamped");
+    CHECK(json_to_int64(objects[2]) == INT64_MIN, "-1e300 isn't clamped");
+    CHECK(json_to_int64(objects[3]) == INT64_MAX, "2^63 isn't clamped");
+    CHECK(json_to_int64(objects[4]) == 12, "12.9 isn't truncated");
+    CHECK(json_to_int64(objects[5]) == -12, "-12.9 isn't truncated");
+    CHECK(json_to_int64(json_new_number(&json, NAN)) == 0, "NaN isn't 0");
+
+    // -0 has to survive a round trip through the serializer
+    char *serialized = json_serialize(json.root, true, 0, NULL);
+    json_t reloaded;
+
+    json_load(&reloaded, serialized);
+
+    json_object_t *zero = json_to_array(reloaded.root, &size)[0];
+
+    CHECK(
+        zero->type == JSON_NUMBER && signbit(zero->data.number),
+        "-0 serialized as \"%s\"", serialized
+    );
+    json_unload(&reloaded);
+    free(serialized);
+
+    // JSON_INTEGER was added after the original types
+    CHECK(
+        JSON_TRUE == 4 && JSON_FALSE == 5 && JSON_NULL == 6
+     && JSON_INTEGER == 7,
+        "json_type_e values moved"
+    );
+
+    json_unload(&json);
+}
+
+static void test_unicode_escapes(void) {
+    char text[] = "{\"s\": \"\\u0041\\u00e9\\u20AC\\uD83D\\uDE00\\u0000!\"}";
+    const char expect[] = "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\0!";
+    char s_key[] = "s", c_key[] = "c";
+    json_t json;
+    size_t len;
+
+    json_load(&json, text);
+
+    json_object_t *str = json_get_object(json.root, s_key);
+    char *decoded = json_to_string_len(str, &len);
+
+    CHECK(
+        len == sizeof(expect) - 1 && !memcmp(decoded, expect, len),
+        "unicode escapes decoded wrong"
+    );
+
+    // every control character is written as an escape the parser reads back
+    char control[32];
+
+    for (int i = 0; i < 31; ++i)
+        control[i] = (char)(i + 1);
+
+    control[31] = '\0';
+    json_put_string(&json, json.root, c_key, control);
+
+    char *serialized = json_serialize(json.root, true, 0, NULL);
+    json_t reloaded;
+
+    json_load(&reloaded, serialized);
+    str = json_get_object(reloaded.root, c_key);
+    decoded = json_to_string_len(str, &len);
+    CHECK(
+        len == 31 && !memcmp(decoded, control, len),
+        "control characters don't round trip"
+    );
+
+    json_unload(&reloaded);
+    free(serialized);
+    json_unload(&json);
+}
+
+// parsing the output of every serializer style gives back the same tree. the
+// numbers are ones which print exactly with %lf
+static void test_serialize_round_trip(void) {
+    char text[] =
+        "{\"a\": [1, -2, 0.5, -12.25, 9223372036854775807, -0, true, false,"
+        " null], \"b\": {\"c\": {}, \"d\": [], \"e\": [[[\"\\\"\\\\\\n\"]]]},"
+        " \"\\u00e9\\t\": \"\\u0001\\u001f/\"}";
+    static const json_write_opts_t styles[] = {
+        {false, 2}, {true, 0}, {false, 4}
+    };
+    json_t json;
+
+    json_load(&json, text);
+
+    char *expect = dump_json(&json);
+
+    for (size_t i = 0; i < sizeof(styles) / sizeof(*styles); ++i) {
+        buf_t out = {NULL, 0, 0};
+        json_t reloaded;
+
+        json_serialize_to(json.root, &styles[i], collect_writer, &out);
+        json_load(&reloaded, out.data);
+
+        char *dump = dump_json(&reloaded);
+
+        CHECK(!strcmp(dump, expect), "style %zu doesn't round trip", i);
+        free(dump);
+        json_unload(&reloaded);
+        free(out.data);
+    }
+
+    free(expect);
+    json_unload(&json);
+}
+
+#ifdef TEST_POSIX
+// runs fn in a child process, which has to exit with an error containing
+// expect. errors which exit can't be checked any other way
+static void check_exits(void (*fn)(void *), void *arg, const char *expect) {
+    buf_t out = {NULL, 0, 0};
+    char chunk[256];
+    int fds[2], status;
+
+    CHECK(!pipe(fds), "couldn't make a pipe");
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+
+    if (!pid) {
+        dup2(fds[1], 1);
+        dup2(fds[1], 2);
+        close(fds[0]);
+        fn(arg);
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    ssize_t got;
+
+    while ((got = read(fds[0], chunk, sizeof(chunk))) > 0)
+        buf_put(&out, chunk, (size_t)got);
+
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    CHECK(
+        WIFEXITED(status) && WEXITSTATUS(status)
+     && out.data && strstr(out.data, expect),
+        "expected an error containing \"%s\", got \"%.200s\"",
+        expect, out.data ? out.data : ""
+    );
+    free(out.data);
+}
+
+static void stream_all(void *path) {
+    json_array_stream_t stream;
+    json_t json;
+
+    json_load_empty(&json);
+    json_array_stream_open(&stream, (const char *)path);
+
+    while (json_array_stream_next(&stream, &json))
+        ;
+}
+
+// depth containers, alternating between arrays and objects
+static char *nested(size_t depth) {
+    buf_t buf = {NULL, 0, 0};
+
+    for (size_t i = 0; i < depth; ++i)
+        buf_puts(&buf, i % 2 ? "{\"k\": " : "[");
+
+    buf_puts(&buf, "0");
+
+    for (size_t i = depth; i-- > 0;)
+        buf_puts(&buf, i % 2 ? "}" : ", 1]");
+
+    return buf_take(&buf);
+}
+
+static void load_lazy_nested(void *depth) {
+    char *text = nested(*(size_t *)depth);
+    json_t json;
+
+    json_load_lazy(&json, text, strlen(text));
+    free(dump_json(&json));
+}
+
+// lazy containers are limited to JSON_MAX_DEPTH like everything else, however
+// deep the expansion which finds the problem
+static void test_lazy_depth(void) {
+    size_t depths[] = {JSON_MAX_DEPTH + 1, 200000};
+    char *text = nested(JSON_MAX_DEPTH);
+    json_t json;
+
+    json_load_lazy(&json, text, strlen(text));
+
+    char *dump = dump_json(&json);
+    char *expect = reference_dump(text, strlen(text));
+
+    CHECK(!strcmp(dump, expect), "json_load_lazy differs at JSON_MAX_DEPTH");
+    free(dump);
+    free(expect);
+    free(text);
+    json_unload(&json);
+
+    for (size_t i = 0; i < sizeof(depths) / sizeof(*depths); ++i) {
+        check_exits(
+            load_lazy_nested, &depths[i], "exceeded maximum depth"
+        );
+    }
+}
+
+// an invalid element is reported wherever it is, including one followed by
+// more than a chunk of text
+static void test_stream_errors(void) {
+    buf_t text = {NULL, 0, 0};
+
+    buf_puts(&text, "[1, [2, }], [");
+
+    for (int i = 0; i < 50000; ++i)
+        buf_puts(&text, "1, ");
+
+    buf_puts(&text, "1]]");
+    write_file("ghh_json_test.json", text.data, text.len);
+    check_exits(stream_all, (void *)"ghh_json_test.json", "expected value");
+
+    // and cut off by the end of the file, after a valid element or not
+    write_file("ghh_json_test.json", text.data, text.len - 3);
+    check_exits(stream_all, (void *)"ghh_json_test.json", "expected value");
+
+    memcpy(text.data + 4, "[2, 3]", 6);
+    write_file("ghh_json_test.json", text.data, text.len - 3);
+    check_exits(stream_all, (void *)"ghh_json_test.json", "expected value");
+
+    remove("ghh_json_test.json");
+    free(text.data);
+}
+#endif
+
+// keys removed with json_pop_ordered leave the rest in order, and the blocks
+// they free are reused as the object grows again
+static void test_pop(void) {
+    // json_put keeps the key pointer, so every key needs its own storage
+    static char names[150][8];
+    json_t json;
+    size_t size;
+
+    for (int i = 0; i < 150; ++i)
+        snprintf(names[i], sizeof(names[i]), i < 100 ? "k%d" : "n%d", i % 100);
+
+    json_load_empty(&json);
+    json.root = json_new_object(&json);
+
+    for (int i = 0; i < 100; ++i)
+        json_put_int64(&json, json.root, names[i], i);
+
+    for (int i = 0; i < 100; i += 3) {
+        json_object_t *popped = json_pop_ordered(&json, json.root, names[i]);
+
+        CHECK(
+            popped && json_to_int64(popped) == i,
+            "json_pop_ordered returned the wrong value for %s", names[i]
+        );
+        CHECK(
+            !json_pop_ordered(&json, json.root, names[i]),
+            "%s was popped twice", names[i]
+        );
+    }
+
+    for (int i = 100; i < 150; ++i)
+        json_put_int64(&json, json.root, names[i], i);
+
+    char **keys = json_get_keys(json.root, &size);
+    size_t at = 0;
+
+    CHECK(size == 66 + 50, "%zu keys left after popping", size);
+
+    for (int i = 0; i < 150 && at < size; ++i) {
+        if (i < 100 && i % 3 == 0)
+            continue;
+
+        CHECK(
+            !strcmp(keys[at], names[i])
+         && json_get_int64(json.root, names[i]) == i,
+            "expected key %s at %zu, got %s", names[i], at, keys[at]
+        );
+        ++at;
+    }
+
+    // unordered pops only have to keep the right keys
+    for (int i = 1; i < 100; i += 3) {
+        CHECK(
+            json_pop(&json, json.root, names[i]),
+            "json_pop lost %s", names[i]
+        );
+    }
+
+    keys = json_get_keys(json.root, &size);
+    CHECK(size == 33 + 50, "%zu keys left after json_pop", size);
+
+    for (size_t i = 0; i < size; ++i) {
+        CHECK(
+            (keys[i][0] == 'n' || atoi(keys[i] + 1) % 3 == 2)
+         && json_get_object(json.root, keys[i]),
+            "unexpected key %s", keys[i]
+        );
+    }
+
+    json_unload(&json);
+}
+
+static void test_validate_errors(void) {
+    static const struct {
+        const char *text;
+        size_t len;
+        const char *message;
+    } cases[] = {
+        {"[\"abc]", 6, "string ended unexpectedly."},
+        {"[\"\\\"]", 5, "string ended unexpectedly."},
+        {"[\"a\\\0\"]", 7, "string ended unexpectedly."},
+        {"[1]\0[", 5, "unexpected null character."},
+        {"[1] 2", 5, "expected json to end with '}' or ']'."},
+        {"{\"a\" 1}", 7, "unknown token, expected \":\"."},
+        {"[\"\\u12\"]", 9, "expected 4 hex digits in unicode escape."},
+        {"[\"\\ud800\"]", 11, "unpaired surrogate in unicode escape."},
+        {"[\"\\udc00\"]", 11, "unpaired surrogate in unicode escape."},
+        {
+            "[\"\\ud800\\u0041\"]", 17,
+            "unpaired surrogate in unicode escape."
+        },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        json_error_t error;
+        char *text = (char *)malloc(cases[i].len);
+
+        memcpy(text, cases[i].text, cases[i].len);
+
+        bool valid = json_validate(text, cases[i].len, &error);
+
+        CHECK(
+            !valid && !strcmp(error.message, cases[i].message),
+            "case %zu: expected \"%s\", got \"%s\"", i,
+            cases[i].message, valid ? "" : error.message
+        );
+
+        free(text);
+    }
+}
+
+int main(void) {
+    test_numbers();
+    test_unicode_escapes();
+    test_serialize_round_trip();
+    test_pop();
+    test_validate_errors();
+    test_steady_state();
+    test_allocator_ex();
+    test_differential();
+#ifdef TEST_POSIX
+    test_stream_errors();
+    test_lazy_depth();
+#endif
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+}